@@ -43,6 +43,10 @@
 #define DEV_LBA 0x40            /* Linear based addressing. */
 #define DEV_DEV 0x10            /* Select device: 0=master, 1=slave. */
 
+/* Most sectors a single READ or WRITE SECTOR command can
+   transfer. */
+#define MAX_SECTORS_PER_CMD 256
+
 /* Commands.
    Many more are defined but this is the small subset that we
    use. */
@@ -86,6 +90,8 @@ static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
 static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sectors (struct ata_disk *, block_sector_t,
+                            block_sector_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -376,10 +382,108 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   lock_release (&c->lock);
 }
 
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   issuing one READ SECTOR command per MAX_SECTORS_PER_CMD
+   sectors.  The disk interrupts once for each sector it has
+   ready.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multi (void *d_, block_sector_t sec_no, block_sector_t cnt,
+                void *buffer_)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  uint8_t *buffer = buffer_;
+
+  lock_acquire (&c->lock);
+  while (cnt > 0)
+    {
+      block_sector_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      block_sector_t i;
+
+      select_sectors (d, sec_no, n);
+      issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < n; i++)
+        {
+          sema_down (&c->completion_wait);
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          input_sector (c, buffer);
+          buffer += BLOCK_SECTOR_SIZE;
+        }
+      sec_no += n;
+      cnt -= n;
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   issuing one WRITE SECTOR command per MAX_SECTORS_PER_CMD
+   sectors.  The disk interrupts after accepting each sector.  If
+   ADVANCE is false, BUFFER holds a single sector that is written
+   to every one of the CNT sectors.
+   Returns after the disk has acknowledged receiving all the data. */
+static void
+write_sectors (struct ata_disk *d, block_sector_t sec_no, block_sector_t cnt,
+               const uint8_t *buffer, bool advance)
+{
+  struct channel *c = d->channel;
+
+  lock_acquire (&c->lock);
+  while (cnt > 0)
+    {
+      block_sector_t n = cnt < MAX_SECTORS_PER_CMD ? cnt : MAX_SECTORS_PER_CMD;
+      block_sector_t i;
+
+      select_sectors (d, sec_no, n);
+      issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+      for (i = 0; i < n; i++)
+        {
+          if (!wait_while_busy (d))
+            PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                   d->name, sec_no + i);
+          output_sector (c, buffer);
+          sema_down (&c->completion_wait);
+          if (advance)
+            buffer += BLOCK_SECTOR_SIZE;
+        }
+      sec_no += n;
+      cnt -= n;
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multi (void *d, block_sector_t sec_no, block_sector_t cnt,
+                 const void *buffer)
+{
+  write_sectors (d, sec_no, cnt, buffer, true);
+}
+
+/* Zeros CNT sectors starting at SEC_NO on disk D, sending the
+   same zeroed sector for each one so that no CNT-sector buffer
+   is needed.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_zeros (void *d, block_sector_t sec_no, block_sector_t cnt)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  write_sectors (d, sec_no, cnt, zeros, false);
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multi,
+    ide_write_multi,
+    ide_write_zeros
   };
 
 /* Selects device D, waiting for it to become ready, and then
@@ -387,13 +491,24 @@ static struct block_operations ide_operations =
    use LBA mode.) */
 static void
 select_sector (struct ata_disk *d, block_sector_t sec_no)
+{
+  select_sectors (d, sec_no, 1);
+}
+
+/* Like select_sector(), but sets up a transfer of CNT sectors,
+   which must be between 1 and MAX_SECTORS_PER_CMD. */
+static void
+select_sectors (struct ata_disk *d, block_sector_t sec_no,
+                block_sector_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= MAX_SECTORS_PER_CMD);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  /* A sector count of 0 means 256. */
+  outb (reg_nsect (c), cnt % MAX_SECTORS_PER_CMD);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
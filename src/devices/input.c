@@ -41,6 +41,30 @@ input_getc (void)
   return key;
 }
 
+/* Moves up to SIZE keys from the input buffer into BUF, stopping
+   early after a new-line or once the buffer is empty, and returns
+   the number moved.  If the buffer is empty and WAIT is true,
+   first waits for a key to be pressed; otherwise returns 0. */
+size_t
+input_read (uint8_t *buf, size_t size, bool wait) 
+{
+  enum intr_level old_level;
+  size_t cnt = 0;
+
+  if (size == 0)
+    return 0;
+
+  old_level = intr_disable ();
+  if (wait || !intq_empty (&buffer))
+    do
+      buf[cnt++] = intq_getc (&buffer);
+    while (cnt < size && buf[cnt - 1] != '\n' && !intq_empty (&buffer));
+  serial_notify ();
+  intr_set_level (old_level);
+
+  return cnt;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
@@ -17,8 +17,9 @@
    protect kernel threads from one another, not from interrupt
    handlers. */
 
-/* Queue buffer size, in bytes. */
-#define INTQ_BUFSIZE 64
+/* Queue buffer size, in bytes.  Large enough that a process
+   writing a few lines to the console only has to queue them. */
+#define INTQ_BUFSIZE 1024
 
 /* A circular queue of bytes. */
 struct intq
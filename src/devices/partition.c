@@ -317,8 +317,39 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
   block_write (p->block, p->start + sector, buffer);
 }
 
+/* Reads CNT sectors starting at SECTOR from partition P into
+   BUFFER. */
+static void
+partition_read_multi (void *p_, block_sector_t sector, block_sector_t cnt,
+                      void *buffer)
+{
+  struct partition *p = p_;
+  block_read_multi (p->block, p->start + sector, cnt, buffer);
+}
+
+/* Writes CNT sectors starting at SECTOR to partition P from
+   BUFFER. */
+static void
+partition_write_multi (void *p_, block_sector_t sector, block_sector_t cnt,
+                       const void *buffer)
+{
+  struct partition *p = p_;
+  block_write_multi (p->block, p->start + sector, cnt, buffer);
+}
+
+/* Zeros CNT sectors starting at SECTOR in partition P. */
+static void
+partition_write_zeros (void *p_, block_sector_t sector, block_sector_t cnt)
+{
+  struct partition *p = p_;
+  block_write_zeros (p->block, p->start + sector, cnt);
+}
+
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    partition_read_multi,
+    partition_write_multi,
+    partition_write_zeros
   };
@@ -37,6 +37,12 @@
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable the receive and transmit FIFOs. */
+
+/* Bytes the transmit FIFO holds. */
+#define TX_FIFO_SIZE 16
+
 /* Line Control Register bits. */
 #define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
 #define LCR_DLAB 0x80           /* Divisor Latch Access Bit (DLAB). */
@@ -88,6 +94,7 @@ serial_init_queue (void)
   ASSERT (mode == POLL);
 
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
+  outb (FCR_REG, FCR_ENABLE);           /* One interrupt per 16 bytes. */
   mode = QUEUE;
   old_level = intr_disable ();
   write_ier ();
@@ -129,6 +136,44 @@ serial_putc (uint8_t byte)
   intr_set_level (old_level);
 }
 
+/* Sends the SIZE bytes in BUF to the serial port.  Like calling
+   serial_putc() on each byte, but in QUEUE mode only touches the
+   interrupt enable register when the transmit queue fills up and
+   once at the end. */
+void
+serial_putbuf (const uint8_t *buf, size_t size) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (mode != QUEUE)
+    {
+      if (mode == UNINIT)
+        init_poll ();
+      while (size-- > 0)
+        putc_poll (*buf++);
+    }
+  else 
+    {
+      while (size-- > 0)
+        {
+          if (intq_full (&txq)) 
+            {
+              /* Same as in serial_putc(), but if we are going to
+                 wait for the queue to drain, make sure the
+                 transmit interrupt is enabled first. */
+              if (old_level == INTR_OFF)
+                putc_poll (intq_getc (&txq));
+              else
+                write_ier ();
+            }
+          intq_putc (&txq, *buf++);
+        }
+      write_ier ();
+    }
+  
+  intr_set_level (old_level);
+}
+
 /* Flushes anything in the serial buffer out the port in polling
    mode. */
 void
@@ -218,10 +263,15 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the transmit FIFO has drained, refill it with as many
+     bytes as it holds. */
+  if ((inb (LSR_REG) & LSR_THRE) != 0)
+    {
+      int i;
+
+      for (i = 0; i < TX_FIFO_SIZE && !intq_empty (&txq); i++)
+        outb (THR_REG, intq_getc (&txq));
+    }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -0,0 +1,20 @@
+/* bench.h
+
+   Helpers shared by the benchmark programs. */
+
+#ifndef EXAMPLES_BENCH_H
+#define EXAMPLES_BENCH_H
+
+#include <stdint.h>
+
+/* Returns the processor's time-stamp counter.  RDTSC is usable
+   from user mode, so this needs no system call. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* examples/bench.h */
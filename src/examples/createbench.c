@@ -0,0 +1,50 @@
+/* createbench.c
+
+   Creates files of increasing initial size and reports the
+   cycles each create() takes, to show how file creation cost
+   scales with the size being created.
+
+   Usage: createbench [MAX-KB]
+   Sizes double from 4 kB up to MAX-KB (default 4096).  The file
+   system needs room for a file of MAX-KB kilobytes, e.g.
+   `pintos --filesys-size=8 ... run "createbench 4096"'. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Number of times each size is created. */
+#define ROUNDS 4
+
+int
+main (int argc, char *argv[])
+{
+  int max_kb = argc > 1 ? atoi (argv[1]) : 4096;
+  int kb, i;
+
+  if (max_kb < 4)
+    {
+      printf ("usage: createbench [MAX-KB]\n");
+      return EXIT_FAILURE;
+    }
+
+  for (kb = 4; kb <= max_kb; kb *= 2)
+    {
+      uint64_t cycles = 0;
+
+      for (i = 0; i < ROUNDS; i++)
+        {
+          uint64_t start = rdtsc ();
+          if (!create ("big", kb * 1024))
+            {
+              printf ("create of %d kB failed\n", kb);
+              return EXIT_FAILURE;
+            }
+          cycles += rdtsc () - start;
+          remove ("big");
+        }
+      printf ("create %5d kB: %llu cycles\n", kb, cycles / ROUNDS);
+    }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,83 @@
+/* dirbench.c
+
+   Creates, opens, and removes many files in one directory and
+   reports the average cost of each operation in cycles.  The
+   file system needs room for one inode sector per file, e.g.
+   `pintos --filesys-size=16 ... run "dirbench 10000"'. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Formats the name of file I into NAME. */
+static void
+make_name (char name[READDIR_MAX_LEN + 1], int i)
+{
+  snprintf (name, READDIR_MAX_LEN + 1, "f%d", i);
+}
+
+/* Prints the average cycles per operation for a phase. */
+static void
+report (const char *phase, uint64_t start, int cnt)
+{
+  printf ("%s: %d files, %llu cycles/file\n",
+          phase, cnt, (rdtsc () - start) / cnt);
+}
+
+int
+main (int argc, char *argv[])
+{
+  char name[READDIR_MAX_LEN + 1];
+  uint64_t start;
+  int cnt = argc > 1 ? atoi (argv[1]) : 10000;
+  int i;
+
+  if (cnt <= 0)
+    {
+      printf ("usage: dirbench [FILE-COUNT]\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      make_name (name, i);
+      if (!create (name, 0))
+        {
+          printf ("%s: create failed\n", name);
+          return EXIT_FAILURE;
+        }
+    }
+  report ("create", start, cnt);
+
+  start = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      int fd;
+
+      make_name (name, i);
+      fd = open (name);
+      if (fd < 0)
+        {
+          printf ("%s: open failed\n", name);
+          return EXIT_FAILURE;
+        }
+      close (fd);
+    }
+  report ("open", start, cnt);
+
+  start = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      make_name (name, i);
+      if (!remove (name))
+        {
+          printf ("%s: remove failed\n", name);
+          return EXIT_FAILURE;
+        }
+    }
+  report ("remove", start, cnt);
+
+  return EXIT_SUCCESS;
+}
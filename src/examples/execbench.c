@@ -0,0 +1,56 @@
+/* execbench.c
+
+   Launches the same trivial program many times in a row, waiting
+   for each one, and reports the cycles per exec() and wait().
+   Every launch after the first loads an executable whose layout
+   the kernel has already seen, as in multi-recurse or
+   exec-multiple.  Passing each child extra arguments shows the
+   cost of handing a longer command line to a new process.
+
+   Usage: execbench [EXECS [ARGS]]
+   EXECS defaults to 50 and ARGS, the extra arguments per child,
+   to 0. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+int
+main (int argc, char *argv[])
+{
+  char cmd[256] = "execbench -c";
+  int execs, args;
+  uint64_t start, cycles;
+  int i;
+
+  if (argc >= 2 && !strcmp (argv[1], "-c"))
+    return EXIT_SUCCESS;
+
+  execs = argc > 1 ? atoi (argv[1]) : 50;
+  args = argc > 2 ? atoi (argv[2]) : 0;
+  if (execs <= 0 || args < 0 || args > 24)
+    {
+      printf ("usage: execbench [EXECS [ARGS]]\n");
+      return EXIT_FAILURE;
+    }
+  for (i = 0; i < args; i++)
+    strlcat (cmd, " argument", sizeof cmd);
+
+  start = rdtsc ();
+  for (i = 0; i < execs; i++)
+    {
+      pid_t pid = exec (cmd);
+      if (pid == PID_ERROR || wait (pid) != EXIT_SUCCESS)
+        {
+          printf ("exec %d failed\n", i);
+          return EXIT_FAILURE;
+        }
+    }
+  cycles = rdtsc () - start;
+
+  printf ("execbench: %d execs with %d arguments, "
+          "%llu cycles per exec and wait\n", execs, args, cycles / execs);
+  return EXIT_SUCCESS;
+}
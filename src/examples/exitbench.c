@@ -0,0 +1,76 @@
+/* exitbench.c
+
+   Repeatedly execs a child that touches PAGES pages of memory and
+   exits, and reports the cycles from exec() until wait() returns.
+   The larger PAGES is, the bigger the address space left to tear
+   down when the child exits; the less that shows up in the
+   result, the less of the teardown its parent waits for.
+
+   Usage: exitbench [PAGES [CHILDREN]]
+   PAGES defaults to 256 and CHILDREN to 16. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Most pages a child touches. */
+#define MAX_PAGES 1024
+
+#define PAGE_SIZE 4096
+
+static char pages[MAX_PAGES][PAGE_SIZE];
+
+/* Dirties the first CNT pages. */
+static int
+child (int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    pages[i][0] = 1;
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  char cmd[32];
+  int cnt, children, i;
+  uint64_t cycles = 0;
+
+  if (argc == 3 && !strcmp (argv[1], "-c"))
+    return child (atoi (argv[2]));
+
+  cnt = argc > 1 ? atoi (argv[1]) : 256;
+  children = argc > 2 ? atoi (argv[2]) : 16;
+  if (cnt < 0 || cnt > MAX_PAGES || children <= 0)
+    {
+      printf ("usage: exitbench [PAGES [CHILDREN]]\n");
+      return EXIT_FAILURE;
+    }
+
+  snprintf (cmd, sizeof cmd, "exitbench -c %d", cnt);
+  for (i = 0; i < children; i++)
+    {
+      uint64_t start = rdtsc ();
+      pid_t pid = exec (cmd);
+
+      if (pid == PID_ERROR)
+        {
+          printf ("exec %d failed\n", i);
+          return EXIT_FAILURE;
+        }
+      if (wait (pid) != EXIT_SUCCESS)
+        {
+          printf ("child %d failed\n", i);
+          return EXIT_FAILURE;
+        }
+      cycles += rdtsc () - start;
+    }
+
+  printf ("exitbench: %d pages, %llu cycles per exec and wait\n",
+          cnt, cycles / children);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,61 @@
+/* fdbench.c
+
+   Opens the same file many times, then issues small reads on
+   the most recently opened descriptor and reports the cycles per
+   read.  Comparing runs with few and many open descriptors shows
+   whether looking up a descriptor gets slower as a process holds
+   more of them.
+
+   Usage: fdbench [FDS]
+   FDS defaults to 256. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Number of reads timed. */
+#define READS 1000
+
+int
+main (int argc, char *argv[])
+{
+  int nfds = argc > 1 ? atoi (argv[1]) : 256;
+  uint64_t start, cycles;
+  int fd = -1, i;
+  char c;
+
+  if (nfds <= 0)
+    {
+      printf ("usage: fdbench [FDS]\n");
+      return EXIT_FAILURE;
+    }
+  if (!create ("fdbench.dat", 1))
+    {
+      printf ("create failed\n");
+      return EXIT_FAILURE;
+    }
+
+  for (i = 0; i < nfds; i++)
+    {
+      fd = open ("fdbench.dat");
+      if (fd < 0)
+        {
+          printf ("open %d failed\n", i);
+          return EXIT_FAILURE;
+        }
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < READS; i++)
+    {
+      seek (fd, 0);
+      read (fd, &c, 1);
+    }
+  cycles = rdtsc () - start;
+
+  printf ("fdbench: %d fds open, %llu cycles per seek and read\n",
+          nfds, cycles / READS);
+  remove ("fdbench.dat");
+  return EXIT_SUCCESS;
+}
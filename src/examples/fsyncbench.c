@@ -0,0 +1,109 @@
+/* fsyncbench.c
+
+   Runs several processes that each repeatedly write a sector of
+   their own file and fsync() it, and reports the average fsync()
+   latency.  Every write allocates a new sector, so each fsync()
+   has metadata to commit.  Comparing runs with 1, 2, 4, ...
+   processes shows how well concurrent fsync() calls share
+   commits: with group commit the latency grows much more slowly
+   than the number of processes.
+
+   Usage: fsyncbench [PROCESSES] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Number of write and fsync() pairs per process. */
+#define ROUNDS 32
+
+static char buf[512];
+
+/* Creates a file named after ID, then writes and syncs each of
+   its sectors in turn, and prints the average cycles per
+   fsync(). */
+static int
+child (int id)
+{
+  char name[16];
+  uint64_t cycles = 0;
+  int fd, round;
+
+  snprintf (name, sizeof name, "fs%d", id);
+  if (!create (name, ROUNDS * sizeof buf))
+    {
+      printf ("%s: create failed\n", name);
+      return EXIT_FAILURE;
+    }
+  fd = open (name);
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", name);
+      return EXIT_FAILURE;
+    }
+
+  memset (buf, id, sizeof buf);
+  for (round = 0; round < ROUNDS; round++)
+    {
+      uint64_t start;
+
+      if (write (fd, buf, sizeof buf) != sizeof buf)
+        {
+          printf ("%s: write failed\n", name);
+          return EXIT_FAILURE;
+        }
+      start = rdtsc ();
+      if (fsync (fd) != 0)
+        {
+          printf ("%s: fsync failed\n", name);
+          return EXIT_FAILURE;
+        }
+      cycles += rdtsc () - start;
+    }
+  printf ("%s: %llu cycles per fsync\n", name, cycles / ROUNDS);
+  close (fd);
+  remove (name);
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  char cmd[32];
+  pid_t pids[64];
+  uint64_t start, cycles;
+  int nproc, i;
+  int status = EXIT_SUCCESS;
+
+  if (argc == 3 && !strcmp (argv[1], "-c"))
+    return child (atoi (argv[2]));
+
+  nproc = argc > 1 ? atoi (argv[1]) : 4;
+  if (nproc <= 0 || nproc > 64)
+    {
+      printf ("usage: fsyncbench [PROCESSES]\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < nproc; i++)
+    {
+      snprintf (cmd, sizeof cmd, "fsyncbench -c %d", i);
+      pids[i] = exec (cmd);
+      if (pids[i] == PID_ERROR)
+        {
+          printf ("exec failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < nproc; i++)
+    if (wait (pids[i]) != EXIT_SUCCESS)
+      status = EXIT_FAILURE;
+  cycles = rdtsc () - start;
+
+  printf ("fsyncbench: %d processes, %d fsyncs, %llu cycles\n",
+          nproc, nproc * ROUNDS, cycles);
+  return status;
+}
@@ -0,0 +1,105 @@
+/* iobench.c
+
+   Runs several processes that each repeatedly read their own
+   file, and reports the aggregate read throughput.  Comparing
+   runs with 1, 2, 4, ... processes shows how well independent
+   file I/O proceeds concurrently.
+
+   Usage: iobench [PROCESSES [KB-PER-FILE]]
+   The file system needs room for PROCESSES files of KB-PER-FILE
+   kilobytes each. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Number of times each process reads its whole file. */
+#define ROUNDS 8
+
+static char buf[4096];
+
+/* Creates a file of KB kilobytes named after ID, then reads it
+   ROUNDS times, interleaving cheap filesize() and tell() calls
+   that should never wait behind another process's I/O. */
+static int
+child (int id, int kb)
+{
+  char name[16];
+  int fd, round, i;
+
+  snprintf (name, sizeof name, "io%d", id);
+  if (!create (name, kb * 1024))
+    {
+      printf ("%s: create failed\n", name);
+      return EXIT_FAILURE;
+    }
+  fd = open (name);
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", name);
+      return EXIT_FAILURE;
+    }
+
+  memset (buf, id, sizeof buf);
+  for (i = 0; i < kb / 4; i++)
+    write (fd, buf, sizeof buf);
+
+  for (round = 0; round < ROUNDS; round++)
+    {
+      seek (fd, 0);
+      while (read (fd, buf, sizeof buf) > 0)
+        if (filesize (fd) != kb * 1024 || tell (fd) == 0)
+          {
+            printf ("%s: bad file state\n", name);
+            return EXIT_FAILURE;
+          }
+    }
+  close (fd);
+  remove (name);
+  return EXIT_SUCCESS;
+}
+
+int
+main (int argc, char *argv[])
+{
+  char cmd[64];
+  pid_t pids[64];
+  uint64_t start, cycles;
+  int nproc, kb, i;
+  int status = EXIT_SUCCESS;
+
+  if (argc == 4 && !strcmp (argv[1], "-c"))
+    return child (atoi (argv[2]), atoi (argv[3]));
+
+  nproc = argc > 1 ? atoi (argv[1]) : 4;
+  kb = argc > 2 ? atoi (argv[2]) : 64;
+  if (nproc <= 0 || nproc > 64 || kb < 4)
+    {
+      printf ("usage: iobench [PROCESSES [KB-PER-FILE]]\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < nproc; i++)
+    {
+      snprintf (cmd, sizeof cmd, "iobench -c %d %d", i, kb);
+      pids[i] = exec (cmd);
+      if (pids[i] == PID_ERROR)
+        {
+          printf ("exec failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < nproc; i++)
+    if (wait (pids[i]) != EXIT_SUCCESS)
+      status = EXIT_FAILURE;
+  cycles = rdtsc () - start;
+
+  printf ("iobench: %d processes, %d kB read, %llu cycles, "
+          "%llu bytes/Mcycle\n",
+          nproc, nproc * kb * ROUNDS, cycles,
+          (uint64_t) nproc * kb * 1024 * ROUNDS * 1000000 / cycles);
+  return status;
+}
@@ -0,0 +1,45 @@
+/* printfbench.c
+
+   Prints a table of numbers one small printf() at a time, the
+   way programs like matmult and hex-dump build up their output,
+   and reports the cycles per line.  With buffered standard
+   output each line costs one write() instead of one per field,
+   and the kernel only has to queue it for the serial port.
+
+   Usage: printfbench [LINES]
+   LINES defaults to 256. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Numbers per line. */
+#define FIELDS 16
+
+int
+main (int argc, char *argv[])
+{
+  int lines = argc > 1 ? atoi (argv[1]) : 256;
+  uint64_t start, cycles;
+  int i, j;
+
+  if (lines <= 0)
+    {
+      printf ("usage: printfbench [LINES]\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < lines; i++)
+    {
+      for (j = 0; j < FIELDS; j++)
+        printf ("%4d", i * FIELDS + j);
+      putchar ('\n');
+    }
+  cycles = rdtsc () - start;
+
+  printf ("printfbench: %d lines, %llu cycles per line\n",
+          lines, cycles / lines);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,86 @@
+/* rwbench.c
+
+   Times system calls whose cost is dominated by checking and
+   copying user memory: a call with only small arguments, and
+   large read() and write() calls on a file, and reports the
+   cycles per call.  Comparing the small call against the large
+   ones shows how much of a transfer is spent validating the user
+   buffer rather than moving data.
+
+   Usage: rwbench [KB]
+   KB is the transfer size per call and defaults to 64. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Number of calls timed for each measurement. */
+#define CALLS 100
+
+/* Largest transfer, in kB. */
+#define MAX_KB 64
+
+static char buf[MAX_KB * 1024];
+
+int
+main (int argc, char *argv[])
+{
+  int kb = argc > 1 ? atoi (argv[1]) : MAX_KB;
+  int size = kb * 1024;
+  uint64_t start, small, wr, rd;
+  int fd, i;
+
+  if (kb <= 0 || kb > MAX_KB)
+    {
+      printf ("usage: rwbench [KB]\n");
+      return EXIT_FAILURE;
+    }
+  if (!create ("rwbench.dat", size))
+    {
+      printf ("create failed\n");
+      return EXIT_FAILURE;
+    }
+  fd = open ("rwbench.dat");
+  if (fd < 0)
+    {
+      printf ("open failed\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < CALLS; i++)
+    tell (fd);
+  small = rdtsc () - start;
+
+  start = rdtsc ();
+  for (i = 0; i < CALLS; i++)
+    {
+      seek (fd, 0);
+      if (write (fd, buf, size) != size)
+        {
+          printf ("write failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  wr = rdtsc () - start;
+
+  start = rdtsc ();
+  for (i = 0; i < CALLS; i++)
+    {
+      seek (fd, 0);
+      if (read (fd, buf, size) != size)
+        {
+          printf ("read failed\n");
+          return EXIT_FAILURE;
+        }
+    }
+  rd = rdtsc () - start;
+
+  printf ("rwbench: %llu cycles per tell\n", small / CALLS);
+  printf ("rwbench: %d kB, %llu cycles per write, %llu cycles per read\n",
+          kb, wr / CALLS, rd / CALLS);
+  close (fd);
+  remove ("rwbench.dat");
+  return EXIT_SUCCESS;
+}
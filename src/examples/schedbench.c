@@ -0,0 +1,82 @@
+/* schedbench.c
+
+   Starts PROCESSES children that each call yield() in a loop, so
+   that all of them are ready to run at once, and reports the
+   cycles per yield and per context switch.  Every child runs once
+   between two yields of another, so a yield costs about PROCESSES
+   switches.  Comparing runs with tens and hundreds of processes
+   shows whether a switch gets slower as more threads are ready.
+
+   Usage: schedbench [PROCESSES [YIELDS]]
+   PROCESSES defaults to 64 and YIELDS to 100. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Most children. */
+#define MAX_PROCESSES 512
+
+/* Yields YIELDS times to let the other children start, then
+   YIELDS more timed, and exits with the cycles per timed yield. */
+static int
+child (int yields)
+{
+  uint64_t start;
+  int i;
+
+  for (i = 0; i < yields; i++)
+    yield ();
+  start = rdtsc ();
+  for (i = 0; i < yields; i++)
+    yield ();
+  return (rdtsc () - start) / yields;
+}
+
+int
+main (int argc, char *argv[])
+{
+  static pid_t pids[MAX_PROCESSES];
+  char cmd[32];
+  int nproc, yields, i;
+  uint64_t cycles = 0;
+
+  if (argc == 3 && !strcmp (argv[1], "-c"))
+    return child (atoi (argv[2]));
+
+  nproc = argc > 1 ? atoi (argv[1]) : 64;
+  yields = argc > 2 ? atoi (argv[2]) : 100;
+  if (nproc <= 0 || nproc > MAX_PROCESSES || yields <= 0)
+    {
+      printf ("usage: schedbench [PROCESSES [YIELDS]]\n");
+      return EXIT_FAILURE;
+    }
+
+  snprintf (cmd, sizeof cmd, "schedbench -c %d", yields);
+  for (i = 0; i < nproc; i++)
+    {
+      pids[i] = exec (cmd);
+      if (pids[i] == PID_ERROR)
+        {
+          printf ("exec %d failed\n", i);
+          return EXIT_FAILURE;
+        }
+    }
+  for (i = 0; i < nproc; i++)
+    {
+      int per_yield = wait (pids[i]);
+      if (per_yield < 0)
+        {
+          printf ("child %d failed\n", i);
+          return EXIT_FAILURE;
+        }
+      cycles += per_yield;
+    }
+
+  printf ("schedbench: %d processes, %llu cycles per yield, "
+          "%llu per switch\n", nproc, cycles / nproc,
+          cycles / nproc / nproc);
+  return EXIT_SUCCESS;
+}
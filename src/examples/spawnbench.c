@@ -0,0 +1,66 @@
+/* spawnbench.c
+
+   Spawns many short-lived children, BATCH at a time: execs a
+   batch, waits for all of it, then starts the next.  Reports the
+   cycles per child.  Each child exits as soon as it starts, so
+   the time goes into creating and tearing down processes.
+
+   Usage: spawnbench [CHILDREN [BATCH]]
+   CHILDREN defaults to 1000 and BATCH to 8. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Largest batch. */
+#define MAX_BATCH 64
+
+int
+main (int argc, char *argv[])
+{
+  pid_t pids[MAX_BATCH];
+  int children, batch, done;
+  uint64_t start, cycles;
+
+  if (argc == 2 && !strcmp (argv[1], "-c"))
+    return EXIT_SUCCESS;
+
+  children = argc > 1 ? atoi (argv[1]) : 1000;
+  batch = argc > 2 ? atoi (argv[2]) : 8;
+  if (children <= 0 || batch <= 0 || batch > MAX_BATCH)
+    {
+      printf ("usage: spawnbench [CHILDREN [BATCH]]\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  for (done = 0; done < children; )
+    {
+      int n = children - done < batch ? children - done : batch;
+      int i;
+
+      for (i = 0; i < n; i++)
+        {
+          pids[i] = exec ("spawnbench -c");
+          if (pids[i] == PID_ERROR)
+            {
+              printf ("exec %d failed\n", done + i);
+              return EXIT_FAILURE;
+            }
+        }
+      for (i = 0; i < n; i++)
+        if (wait (pids[i]) != EXIT_SUCCESS)
+          {
+            printf ("child %d failed\n", done + i);
+            return EXIT_FAILURE;
+          }
+      done += n;
+    }
+  cycles = rdtsc () - start;
+
+  printf ("spawnbench: %d children in batches of %d, "
+          "%llu cycles per child\n", children, batch, cycles / children);
+  return EXIT_SUCCESS;
+}
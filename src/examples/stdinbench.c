@@ -0,0 +1,53 @@
+/* stdinbench.c
+
+   Reads BYTES bytes of console input, as fed to the serial port
+   by a pipe or file, in reads of up to 4 kB, and reports the
+   number of read() calls along with the cycles per byte.  With
+   buffered console input each read() returns a whole line or
+   whatever has arrived so far, so the calls should number far
+   fewer than the bytes.
+
+   Usage: stdinbench [BYTES]
+   BYTES defaults to 1048576, e.g.
+     head -c 1048576 /dev/zero | pintos -- run 'stdinbench' */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "bench.h"
+
+static char buf[4096];
+
+int
+main (int argc, char *argv[])
+{
+  int bytes = argc > 1 ? atoi (argv[1]) : 1024 * 1024;
+  int total = 0, calls = 0;
+  uint64_t start, cycles;
+
+  if (bytes <= 0)
+    {
+      printf ("usage: stdinbench [BYTES]\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  while (total < bytes)
+    {
+      int want = bytes - total < (int) sizeof buf ? bytes - total
+                                                  : (int) sizeof buf;
+      int n = read (STDIN_FILENO, buf, want);
+      if (n <= 0)
+        {
+          printf ("read failed after %d bytes\n", total);
+          return EXIT_FAILURE;
+        }
+      total += n;
+      calls++;
+    }
+  cycles = rdtsc () - start;
+
+  printf ("stdinbench: %d bytes in %d reads, %llu cycles per byte\n",
+          total, calls, cycles / total);
+  return EXIT_SUCCESS;
+}
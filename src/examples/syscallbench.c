@@ -0,0 +1,56 @@
+/* syscallbench.c
+
+   Measures the round-trip cost of system calls in cycles: a
+   near-null call (isdir() on a descriptor that is not open,
+   which fails as soon as its argument is looked up) and tell()
+   on an open file.  Both are dominated by trapping into the
+   kernel and fetching arguments from the user stack.
+
+   Usage: syscallbench [CALLS]
+   CALLS defaults to 10000. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include "bench.h"
+
+int
+main (int argc, char *argv[])
+{
+  int calls = argc > 1 ? atoi (argv[1]) : 10000;
+  uint64_t start, null_cycles, tell_cycles;
+  int fd, i;
+
+  if (calls <= 0)
+    {
+      printf ("usage: syscallbench [CALLS]\n");
+      return EXIT_FAILURE;
+    }
+  if (!create ("syscallbench.dat", 0))
+    {
+      printf ("create failed\n");
+      return EXIT_FAILURE;
+    }
+  fd = open ("syscallbench.dat");
+  if (fd < 0)
+    {
+      printf ("open failed\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  for (i = 0; i < calls; i++)
+    isdir (-1);
+  null_cycles = rdtsc () - start;
+
+  start = rdtsc ();
+  for (i = 0; i < calls; i++)
+    tell (fd);
+  tell_cycles = rdtsc () - start;
+
+  printf ("syscallbench: %llu cycles per null call, %llu cycles per tell\n",
+          null_cycles / calls, tell_cycles / calls);
+  close (fd);
+  remove ("syscallbench.dat");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+/* vecbench.c
+
+   Compares random-access reads done with seek() plus read()
+   against pread(), and scattered small writes done one write()
+   at a time against writev(), reporting the number of system
+   calls and the average cycles per record for each.
+
+   Usage: vecbench [RECORDS]
+   The file system needs room for RECORDS 64-byte records. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Size of one record. */
+#define RECORD_SIZE 64
+
+/* Records per writev() call. */
+#define BATCH 16
+
+static char records[BATCH][RECORD_SIZE];
+
+/* Returns the record visited Ith out of CNT.  The stride is odd
+   and CNT is a power of two, so every record is visited once, out
+   of order. */
+static int
+record_at (int i, int cnt)
+{
+  return (i * 97) & (cnt - 1);
+}
+
+/* Prints the cost of a phase. */
+static void
+report (const char *phase, uint64_t start, int cnt, int syscalls)
+{
+  printf ("%s: %d records, %d system calls, %llu cycles/record\n",
+          phase, cnt, syscalls, (rdtsc () - start) / cnt);
+}
+
+int
+main (int argc, char *argv[])
+{
+  struct iovec iov[BATCH];
+  char buf[RECORD_SIZE];
+  uint64_t start;
+  int cnt = argc > 1 ? atoi (argv[1]) : 1024;
+  int fd, i, j;
+
+  if (cnt < BATCH || (cnt & (cnt - 1)) != 0)
+    {
+      printf ("usage: vecbench [RECORDS], RECORDS a power of 2 >= %d\n",
+              BATCH);
+      return EXIT_FAILURE;
+    }
+
+  if (!create ("vec", cnt * RECORD_SIZE))
+    {
+      printf ("vec: create failed\n");
+      return EXIT_FAILURE;
+    }
+  fd = open ("vec");
+  if (fd < 0)
+    {
+      printf ("vec: open failed\n");
+      return EXIT_FAILURE;
+    }
+
+  for (j = 0; j < BATCH; j++)
+    {
+      memset (records[j], 'a' + j, RECORD_SIZE);
+      iov[j].iov_base = records[j];
+      iov[j].iov_len = RECORD_SIZE;
+    }
+
+  /* Sequential small writes. */
+  start = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    write (fd, records[i % BATCH], RECORD_SIZE);
+  report ("write", start, cnt, cnt);
+
+  seek (fd, 0);
+  start = rdtsc ();
+  for (i = 0; i < cnt; i += BATCH)
+    if (writev (fd, iov, BATCH) != BATCH * RECORD_SIZE)
+      {
+        printf ("vec: writev failed\n");
+        return EXIT_FAILURE;
+      }
+  report ("writev", start, cnt, cnt / BATCH);
+
+  /* Random-access reads. */
+  start = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      seek (fd, record_at (i, cnt) * RECORD_SIZE);
+      read (fd, buf, RECORD_SIZE);
+    }
+  report ("seek+read", start, cnt, 2 * cnt);
+
+  start = rdtsc ();
+  for (i = 0; i < cnt; i++)
+    {
+      int r = record_at (i, cnt);
+      if (pread (fd, buf, RECORD_SIZE, r * RECORD_SIZE) != RECORD_SIZE
+          || buf[0] != 'a' + r % BATCH)
+        {
+          printf ("vec: pread of record %d failed\n", r);
+          return EXIT_FAILURE;
+        }
+    }
+  report ("pread", start, cnt, cnt);
+
+  close (fd);
+  remove ("vec");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,113 @@
+/* waitbench.c
+
+   Starts CHILDREN children at once, each spinning for a time that
+   shrinks with its index so that they exit roughly in reverse
+   order, then reaps them.  Runs twice: once waiting for the
+   children in the order they were started with wait(), and once
+   taking each as it exits with wait_any().  Reports the cycles
+   per child for both and checks that every exit status arrives.
+
+   Usage: waitbench [CHILDREN]
+   CHILDREN defaults to 32. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Most children at once. */
+#define MAX_CHILDREN 64
+
+/* Iterations a child spins for per index below the last. */
+#define SPIN 20000
+
+/* Spins for longer the lower ID is, then exits with ID. */
+static int
+child (int id, int children)
+{
+  volatile int i;
+
+  for (i = 0; i < (children - id) * SPIN; i++)
+    continue;
+  return id;
+}
+
+/* Starts CHILDREN children, storing their pids in PIDS.  Returns
+   false if an exec fails. */
+static bool
+start_children (pid_t pids[], int children)
+{
+  char cmd[48];
+  int i;
+
+  for (i = 0; i < children; i++)
+    {
+      snprintf (cmd, sizeof cmd, "waitbench -c %d %d", i, children);
+      pids[i] = exec (cmd);
+      if (pids[i] == PID_ERROR)
+        {
+          printf ("exec %d failed\n", i);
+          return false;
+        }
+    }
+  return true;
+}
+
+int
+main (int argc, char *argv[])
+{
+  pid_t pids[MAX_CHILDREN];
+  bool seen[MAX_CHILDREN];
+  uint64_t start, in_order, any_order;
+  int children, status, i;
+
+  if (argc == 4 && !strcmp (argv[1], "-c"))
+    return child (atoi (argv[2]), atoi (argv[3]));
+
+  children = argc > 1 ? atoi (argv[1]) : 32;
+  if (children <= 0 || children > MAX_CHILDREN)
+    {
+      printf ("usage: waitbench [CHILDREN]\n");
+      return EXIT_FAILURE;
+    }
+
+  start = rdtsc ();
+  if (!start_children (pids, children))
+    return EXIT_FAILURE;
+  for (i = 0; i < children; i++)
+    if (wait (pids[i]) != i)
+      {
+        printf ("child %d: bad exit status\n", i);
+        return EXIT_FAILURE;
+      }
+  in_order = rdtsc () - start;
+
+  memset (seen, 0, sizeof seen);
+  start = rdtsc ();
+  if (!start_children (pids, children))
+    return EXIT_FAILURE;
+  for (i = 0; i < children; i++)
+    {
+      pid_t pid = wait_any (&status);
+      if (pid == PID_ERROR || status < 0 || status >= children
+          || pids[status] != pid || seen[status])
+        {
+          printf ("wait_any %d: bad child\n", i);
+          return EXIT_FAILURE;
+        }
+      seen[status] = true;
+    }
+  any_order = rdtsc () - start;
+
+  if (wait_any (&status) != PID_ERROR)
+    {
+      printf ("wait_any: reaped a child twice\n");
+      return EXIT_FAILURE;
+    }
+
+  printf ("waitbench: %d children, %llu cycles per child with wait, "
+          "%llu with wait_any\n", children, in_order / children,
+          any_order / children);
+  return EXIT_SUCCESS;
+}
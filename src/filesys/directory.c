@@ -1,10 +1,13 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,12 +24,168 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Identifies a hashed directory. */
+#define DIR_MAGIC 0x48444952
+
+/* Directory header.
+   Stored in the first slot of every directory, in place of a
+   `struct dir_entry', so it must be exactly the same size.  The
+   remaining slots form an open-addressed hash table: an entry
+   named NAME lives in the first free slot at or after
+   hash_string (NAME) modulo the number of slots. */
+struct dir_header
+  {
+    unsigned magic;                     /* Magic number. */
+    uint32_t live_cnt;                  /* Number of entries in use. */
+    uint32_t used_cnt;                  /* Entries in use or deleted. */
+    block_sector_t parent;              /* Parent directory's sector. */
+    uint8_t unused[4];                  /* Not used. */
+  };
+
+/* Maximum number of directories whose index is kept in memory. */
+#define DIR_INDEX_CNT 8
+
+/* In-memory index of the entries of one directory, so that
+   repeated lookups of the same names don't touch the disk. */
+struct dir_index
+  {
+    struct list_elem elem;              /* Element in dir_indexes. */
+    block_sector_t sector;              /* Directory's inode sector. */
+    struct hash entries;                /* Cached dir_index_entry's. */
+  };
+
+/* A cached directory entry. */
+struct dir_index_entry
+  {
+    struct hash_elem elem;              /* Element in dir_index. */
+    block_sector_t inode_sector;        /* Sector number of header. */
+    off_t ofs;                          /* Offset of entry in directory. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+  };
+
+/* Directory indexes, most recently used first. */
+static struct list dir_indexes;
+static struct lock dir_index_lock;
+
+/* Maximum number of names kept in the name cache. */
+#define NAME_CACHE_CNT 256
+
+/* The result of looking up NAME in the directory whose inode is
+   in DIR_SECTOR.  Unlike directory indexes, which serve adding
+   and removing entries in a few directories, the name cache
+   serves path lookup across the whole tree, so it is kept per
+   name and also remembers names that do not exist. */
+struct name_entry
+  {
+    struct hash_elem elem;              /* Element in name_cache. */
+    struct list_elem lru_elem;          /* Element in name_lru. */
+    block_sector_t dir_sector;          /* Directory looked in. */
+    block_sector_t inode_sector;        /* Result, 0 if no such name. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+  };
+
+/* Name cache, and its entries, least recently used first. */
+static struct hash name_cache;
+static struct list name_lru;
+static struct lock name_cache_lock;
+
+static bool read_header (struct dir *, struct dir_header *);
+static bool write_header (struct dir *, const struct dir_header *);
+static bool rehash (struct dir *, struct dir_header *, size_t slot_cnt);
+
+static bool index_find (const struct dir *, const char *name,
+                        struct dir_entry *, off_t *);
+static void index_insert (const struct dir *, const struct dir_entry *,
+                          off_t);
+static void index_remove (const struct dir *, const char *name);
+static void index_drop (block_sector_t);
+
+static hash_hash_func name_entry_hash;
+static hash_less_func name_entry_less;
+static bool name_find (const struct dir *, const char *name,
+                       block_sector_t *);
+static void name_put (const struct dir *, const char *name,
+                      block_sector_t);
+static void name_drop (block_sector_t);
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  list_init (&dir_indexes);
+  lock_init (&dir_index_lock);
+  hash_init (&name_cache, name_entry_hash, name_entry_less, NULL);
+  list_init (&name_lru);
+  lock_init (&name_cache_lock);
+}
+
+/* Returns the number of hash slots in DIR, not counting the
+   header. */
+static size_t
+slot_cnt (const struct dir *dir)
+{
+  size_t entry_cnt = inode_length (dir->inode) / sizeof (struct dir_entry);
+  return entry_cnt > 0 ? entry_cnt - 1 : 0;
+}
+
+/* Returns the byte offset of hash slot SLOT. */
+static off_t
+slot_to_ofs (size_t slot)
+{
+  return (slot + 1) * sizeof (struct dir_entry);
+}
+
+/* Returns the slot at which a probe for NAME in a directory with
+   SLOT_CNT slots begins. */
+static size_t
+home_slot (const char *name, size_t slot_cnt)
+{
+  return hash_string (name) % slot_cnt;
+}
+
+/* Returns true if E has never held an entry.  Such a slot ends a
+   probe sequence; a deleted slot, which keeps its name, does
+   not. */
+static bool
+slot_empty (const struct dir_entry *e)
+{
+  return !e->in_use && e->name[0] == '\0';
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR, whose parent directory is in sector PARENT.  The
+   root directory is its own parent.  Returns true if successful,
+   false on failure. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, block_sector_t parent, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_header h;
+  struct dir *dir;
+  bool success;
+
+  /* If this assertion fails, the header no longer fits in a
+     directory slot. */
+  ASSERT (sizeof h == sizeof (struct dir_entry));
+
+  if (entry_cnt == 0)
+    entry_cnt = 1;
+  if (!inode_create (sector, (entry_cnt + 1) * sizeof (struct dir_entry),
+                     true))
+    return false;
+
+  dir = dir_open (inode_open (sector));
+  if (dir == NULL)
+    return false;
+  memset (&h, 0, sizeof h);
+  h.magic = DIR_MAGIC;
+  h.parent = parent;
+  success = write_header (dir, &h);
+  dir_close (dir);
+
+  /* A new directory may reuse the sector of a removed one. */
+  index_drop (sector);
+  name_drop (sector);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -37,6 +196,7 @@ dir_open (struct inode *inode)
   struct dir *dir = calloc (1, sizeof *dir);
   if (inode != NULL && dir != NULL)
     {
+      inode_set_metadata (inode);
       dir->inode = inode;
       dir->pos = 0;
       return dir;
@@ -93,41 +253,118 @@ lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
   struct dir_entry e;
-  size_t ofs;
+  size_t cnt = slot_cnt (dir);
+  size_t slot, i;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
+  if (index_find (dir, name, ep, ofsp))
+    return true;
+  if (cnt == 0)
+    return false;
+
+  /* Probe from NAME's home slot until we find it or reach a slot
+     that has never been used. */
+  for (i = 0, slot = home_slot (name, cnt); i < cnt;
+       i++, slot = (slot + 1) % cnt)
+    {
+      off_t ofs = slot_to_ofs (slot);
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+          || slot_empty (&e))
+        break;
+      if (e.in_use && !strcmp (name, e.name)) 
+        {
+          index_insert (dir, &e, ofs);
+          if (ep != NULL)
+            *ep = e;
+          if (ofsp != NULL)
+            *ofsp = ofs;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Stores E in the first free slot of DIR's probe sequence for
+   E's name, updating *H to match.  Does not write *H back.
+   Returns true if successful, false on failure. */
+static bool
+place_entry (struct dir *dir, struct dir_header *h,
+             const struct dir_entry *e, off_t *ofsp)
+{
+  struct dir_entry slot_e;
+  size_t cnt = slot_cnt (dir);
+  size_t slot, i;
+
+  for (i = 0, slot = home_slot (e->name, cnt); i < cnt;
+       i++, slot = (slot + 1) % cnt)
+    {
+      off_t ofs = slot_to_ofs (slot);
+      if (inode_read_at (dir->inode, &slot_e, sizeof slot_e, ofs)
+          != sizeof slot_e)
+        return false;
+      if (!slot_e.in_use)
+        {
+          if (inode_write_at (dir->inode, e, sizeof *e, ofs) != sizeof *e)
+            return false;
+          if (slot_empty (&slot_e))
+            h->used_cnt++;
+          h->live_cnt++;
+          if (ofsp != NULL)
+            *ofsp = ofs;
+          return true;
+        }
+    }
   return false;
 }
 
+/* Returns true if NAME is "." or "..", which every directory
+   implicitly contains. */
+static bool
+is_dot_name (const char *name)
+{
+  return !strcmp (name, ".") || !strcmp (name, "..");
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   "." names DIR itself and ".." its parent. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  struct dir_header h;
   struct dir_entry e;
+  block_sector_t sector;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  *inode = NULL;
+  inode_lock (dir->inode);
+  if (!strcmp (name, "."))
+    *inode = inode_reopen (dir->inode);
+  else if (!strcmp (name, ".."))
+    {
+      if (read_header ((struct dir *) dir, &h))
+        *inode = inode_open (h.parent);
+    }
+  else if (name_find (dir, name, &sector))
+    {
+      if (sector != 0)
+        *inode = inode_open (sector);
+    }
+  else if (lookup (dir, name, &e, NULL))
+    {
+      name_put (dir, name, e.inode_sector);
+      *inode = inode_open (e.inode_sector);
+    }
   else
-    *inode = NULL;
+    name_put (dir, name, 0);
+  inode_unlock (dir->inode);
 
   return *inode != NULL;
 }
@@ -141,6 +378,7 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  struct dir_header h;
   struct dir_entry e;
   off_t ofs;
   bool success = false;
@@ -149,43 +387,58 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   ASSERT (name != NULL);
 
   /* Check NAME for validity. */
-  if (*name == '\0' || strlen (name) > NAME_MAX)
+  if (*name == '\0' || strlen (name) > NAME_MAX || is_dot_name (name))
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  /* Check that NAME is not in use, and that DIR has not been
+     removed, since nothing could find an entry added to it. */
+  inode_lock (dir->inode);
+  if (inode_is_removed (dir->inode) || lookup (dir, name, NULL, NULL))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  /* Keep the table at most 3/4 full, counting deleted slots,
+     so that probe sequences stay short.  Deleted slots are
+     dropped by rehashing, so only grow if live entries alone
+     would fill half of the new table. */
+  if (!read_header (dir, &h))
+    goto done;
+  if ((h.used_cnt + 1) * 4 > slot_cnt (dir) * 3)
+    {
+      size_t cnt = slot_cnt (dir) > 0 ? slot_cnt (dir) : 1;
+      while ((h.live_cnt + 1) * 2 > cnt)
+        cnt *= 2;
+      if (!rehash (dir, &h, cnt))
+        goto done;
+    }
 
   /* Write slot. */
+  memset (&e, 0, sizeof e);
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  success = place_entry (dir, &h, &e, &ofs) && write_header (dir, &h);
+  if (success)
+    {
+      index_insert (dir, &e, ofs);
+      name_put (dir, name, inode_sector);
+    }
 
  done:
+  inode_unlock (dir->inode);
   return success;
 }
 
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs
+   only if there is no file with the given NAME or it is a
+   directory that is not empty. */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_header h;
   struct dir_entry e;
   struct inode *inode = NULL;
+  bool locked = false;
   bool success = false;
   off_t ofs;
 
@@ -193,6 +446,9 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
+  if (is_dot_name (name))
+    return false;
+  inode_lock (dir->inode);
   if (!lookup (dir, name, &e, &ofs))
     goto done;
 
@@ -201,36 +457,437 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
-  /* Erase directory entry. */
+  /* Only an empty directory may be removed.  Its lock, always
+     taken after its parent's, keeps entries from being added to
+     it until it is marked removed. */
+  if (inode_is_dir (inode))
+    {
+      struct dir child;
+      child.inode = inode;
+      child.pos = 0;
+      inode_lock (inode);
+      locked = true;
+      if (!read_header (&child, &h) || h.live_cnt != 0)
+        goto done;
+    }
+
+  /* Erase directory entry.  It keeps its name, marking the slot
+     as deleted rather than empty, so that probes for entries
+     placed after it continue past it. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  index_remove (dir, name);
+  name_put (dir, name, 0);
+  if (read_header (dir, &h))
+    {
+      h.live_cnt--;
+      write_header (dir, &h);
+    }
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  if (locked)
+    inode_unlock (inode);
+  inode_unlock (dir->inode);
   inode_close (inode);
   return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+   contains no more entries.  Entries are returned in hash order,
+   which changes when an added entry makes the directory grow. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
 
+  bool success = false;
+
+  /* Skip the header. */
+  if (dir->pos < (off_t) sizeof e)
+    dir->pos = sizeof e;
+
+  inode_lock (dir->inode);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          success = true;
+          break;
         } 
     }
-  return false;
+  inode_unlock (dir->inode);
+  return success;
+}
+
+/* Reads DIR's header into *H.
+   Returns true if successful, false on failure. */
+static bool
+read_header (struct dir *dir, struct dir_header *h)
+{
+  return (inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+          && h->magic == DIR_MAGIC);
+}
+
+/* Writes H as DIR's header.
+   Returns true if successful, false on failure. */
+static bool
+write_header (struct dir *dir, const struct dir_header *h)
+{
+  return inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
+/* Rebuilds DIR with SLOT_CNT hash slots, dropping deleted
+   entries, and updates *H to DIR's new header.  The entries are
+   placed in a scratch directory whose data is then swapped into
+   DIR's inode, so DIR keeps its sector.
+
+   The scratch directory is not marked as metadata, so its data
+   is written in place instead of through the journal.  Nothing
+   refers to those sectors until the logged swap commits, which
+   happens after they are written, so a crash before then loses
+   nothing.  This keeps the journal's share of a rehash to a few
+   inode, index and free map sectors however large DIR is.
+   Returns true if successful, false on failure, in which case
+   DIR is unchanged. */
+static bool
+rehash (struct dir *dir, struct dir_header *h, size_t slot_cnt)
+{
+  block_sector_t sector = 0;
+  struct dir new_dir;
+  struct dir_header new_h;
+  struct dir_entry e;
+  off_t ofs;
+  bool success = false;
+
+  if (!free_map_allocate (1, &sector))
+    return false;
+  if (!inode_create (sector, (slot_cnt + 1) * sizeof e, true))
+    {
+      free_map_release (sector, 1);
+      return false;
+    }
+  new_dir.inode = inode_open (sector);
+  new_dir.pos = 0;
+  if (new_dir.inode == NULL)
+    {
+      free_map_release (sector, 1);
+      return false;
+    }
+
+  memset (&new_h, 0, sizeof new_h);
+  new_h.magic = DIR_MAGIC;
+  new_h.parent = h->parent;
+  for (ofs = sizeof e;
+       inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    if (e.in_use && !place_entry (&new_dir, &new_h, &e, NULL))
+      goto done;
+  if (!write_header (&new_dir, &new_h))
+    goto done;
+
+  /* Entry offsets have all changed. */
+  inode_swap_data (dir->inode, new_dir.inode);
+  index_drop (inode_get_inumber (dir->inode));
+  *h = new_h;
+  success = true;
+
+ done:
+  /* Frees DIR's old data on success or the new data on failure,
+     together with the scratch inode. */
+  inode_remove (new_dir.inode);
+  inode_close (new_dir.inode);
+  return success;
+}
+
+/* Returns a hash value for dir_index_entry E. */
+static unsigned
+index_entry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_string (hash_entry (e, struct dir_index_entry, elem)->name);
+}
+
+/* Returns true if dir_index_entry A's name precedes B's. */
+static bool
+index_entry_less (const struct hash_elem *a, const struct hash_elem *b,
+                  void *aux UNUSED)
+{
+  return strcmp (hash_entry (a, struct dir_index_entry, elem)->name,
+                 hash_entry (b, struct dir_index_entry, elem)->name) < 0;
+}
+
+/* Frees dir_index_entry E. */
+static void
+index_entry_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct dir_index_entry, elem));
+}
+
+/* Returns the index for the directory in SECTOR and marks it as
+   most recently used.  If there is none and CREATE is true,
+   creates one, evicting the least recently used index if there
+   are too many; otherwise returns a null pointer.
+   Must be called with dir_index_lock held. */
+static struct dir_index *
+index_get (block_sector_t sector, bool create)
+{
+  struct dir_index *index;
+  struct list_elem *e;
+
+  for (e = list_begin (&dir_indexes); e != list_end (&dir_indexes);
+       e = list_next (e))
+    {
+      index = list_entry (e, struct dir_index, elem);
+      if (index->sector == sector)
+        {
+          list_remove (&index->elem);
+          list_push_front (&dir_indexes, &index->elem);
+          return index;
+        }
+    }
+  if (!create)
+    return NULL;
+
+  if (list_size (&dir_indexes) >= DIR_INDEX_CNT)
+    {
+      index = list_entry (list_pop_back (&dir_indexes),
+                          struct dir_index, elem);
+      hash_destroy (&index->entries, index_entry_free);
+    }
+  else
+    {
+      index = malloc (sizeof *index);
+      if (index == NULL)
+        return NULL;
+    }
+  index->sector = sector;
+  if (!hash_init (&index->entries, index_entry_hash, index_entry_less, NULL))
+    {
+      free (index);
+      return NULL;
+    }
+  list_push_front (&dir_indexes, &index->elem);
+  return index;
+}
+
+/* Looks up NAME in DIR's index.  If found, returns true and
+   sets *EP and *OFSP as for lookup(), otherwise returns false. */
+static bool
+index_find (const struct dir *dir, const char *name,
+            struct dir_entry *ep, off_t *ofsp)
+{
+  struct dir_index *index;
+  struct dir_index_entry key;
+  struct hash_elem *e = NULL;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+  strlcpy (key.name, name, sizeof key.name);
+
+  lock_acquire (&dir_index_lock);
+  index = index_get (inode_get_inumber (dir->inode), false);
+  if (index != NULL)
+    e = hash_find (&index->entries, &key.elem);
+  if (e != NULL)
+    {
+      struct dir_index_entry *ie = hash_entry (e, struct dir_index_entry,
+                                               elem);
+      if (ep != NULL)
+        {
+          memset (ep, 0, sizeof *ep);
+          ep->inode_sector = ie->inode_sector;
+          strlcpy (ep->name, ie->name, sizeof ep->name);
+          ep->in_use = true;
+        }
+      if (ofsp != NULL)
+        *ofsp = ie->ofs;
+    }
+  lock_release (&dir_index_lock);
+  return e != NULL;
+}
+
+/* Adds entry E, at offset OFS, to DIR's index.  The index is
+   only a cache, so failure to allocate memory is ignored. */
+static void
+index_insert (const struct dir *dir, const struct dir_entry *e, off_t ofs)
+{
+  struct dir_index *index;
+  struct dir_index_entry *ie;
+
+  lock_acquire (&dir_index_lock);
+  index = index_get (inode_get_inumber (dir->inode), true);
+  if (index != NULL && (ie = malloc (sizeof *ie)) != NULL)
+    {
+      struct hash_elem *old;
+
+      ie->inode_sector = e->inode_sector;
+      ie->ofs = ofs;
+      strlcpy (ie->name, e->name, sizeof ie->name);
+      old = hash_replace (&index->entries, &ie->elem);
+      if (old != NULL)
+        index_entry_free (old, NULL);
+    }
+  lock_release (&dir_index_lock);
+}
+
+/* Removes NAME from DIR's index, if present. */
+static void
+index_remove (const struct dir *dir, const char *name)
+{
+  struct dir_index *index;
+  struct dir_index_entry key;
+  struct hash_elem *e;
+
+  strlcpy (key.name, name, sizeof key.name);
+  lock_acquire (&dir_index_lock);
+  index = index_get (inode_get_inumber (dir->inode), false);
+  if (index != NULL && (e = hash_delete (&index->entries, &key.elem)) != NULL)
+    index_entry_free (e, NULL);
+  lock_release (&dir_index_lock);
+}
+
+/* Discards the index of the directory in SECTOR, if any. */
+static void
+index_drop (block_sector_t sector)
+{
+  struct dir_index *index;
+
+  lock_acquire (&dir_index_lock);
+  index = index_get (sector, false);
+  if (index != NULL)
+    {
+      list_remove (&index->elem);
+      hash_destroy (&index->entries, index_entry_free);
+      free (index);
+    }
+  lock_release (&dir_index_lock);
+}
+
+/* Returns a hash value for name_entry E. */
+static unsigned
+name_entry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct name_entry *ne = hash_entry (e, struct name_entry, elem);
+  return hash_string (ne->name) ^ hash_int (ne->dir_sector);
+}
+
+/* Returns true if name_entry A precedes B. */
+static bool
+name_entry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                 void *aux UNUSED)
+{
+  const struct name_entry *a = hash_entry (a_, struct name_entry, elem);
+  const struct name_entry *b = hash_entry (b_, struct name_entry, elem);
+  if (a->dir_sector != b->dir_sector)
+    return a->dir_sector < b->dir_sector;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Returns the name cache entry for NAME in the directory in
+   DIR_SECTOR, or a null pointer if there is none.
+   Must be called with name_cache_lock held. */
+static struct name_entry *
+name_get (block_sector_t dir_sector, const char *name)
+{
+  struct name_entry key;
+  struct hash_elem *e;
+
+  key.dir_sector = dir_sector;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&name_cache, &key.elem);
+  return e != NULL ? hash_entry (e, struct name_entry, elem) : NULL;
+}
+
+/* Looks up NAME in DIR in the name cache.  If found, returns true
+   and sets *SECTORP to the sector of NAME's inode, or to 0 if DIR
+   is known to have no entry NAME; otherwise returns false.
+   DIR's inode must be locked. */
+static bool
+name_find (const struct dir *dir, const char *name, block_sector_t *sectorp)
+{
+  struct name_entry *ne;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+  lock_acquire (&name_cache_lock);
+  ne = name_get (inode_get_inumber (dir->inode), name);
+  if (ne != NULL)
+    {
+      list_remove (&ne->lru_elem);
+      list_push_back (&name_lru, &ne->lru_elem);
+      *sectorp = ne->inode_sector;
+    }
+  lock_release (&name_cache_lock);
+  return ne != NULL;
+}
+
+/* Records in the name cache that NAME in DIR refers to the inode
+   in SECTOR, or to nothing if SECTOR is 0, evicting the least
+   recently used name if the cache is full.  The cache is only a
+   cache, so failure to allocate memory is ignored.  DIR's inode
+   must be locked. */
+static void
+name_put (const struct dir *dir, const char *name, block_sector_t sector)
+{
+  block_sector_t dir_sector = inode_get_inumber (dir->inode);
+  struct name_entry *ne;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+  lock_acquire (&name_cache_lock);
+  ne = name_get (dir_sector, name);
+  if (ne != NULL)
+    list_remove (&ne->lru_elem);
+  else
+    {
+      if (hash_size (&name_cache) >= NAME_CACHE_CNT)
+        {
+          ne = list_entry (list_pop_front (&name_lru),
+                           struct name_entry, lru_elem);
+          hash_delete (&name_cache, &ne->elem);
+        }
+      else
+        ne = malloc (sizeof *ne);
+      if (ne != NULL)
+        {
+          ne->dir_sector = dir_sector;
+          strlcpy (ne->name, name, sizeof ne->name);
+          hash_insert (&name_cache, &ne->elem);
+        }
+    }
+  if (ne != NULL)
+    {
+      ne->inode_sector = sector;
+      list_push_back (&name_lru, &ne->lru_elem);
+    }
+  lock_release (&name_cache_lock);
+}
+
+/* Discards every name cache entry for the directory in
+   DIR_SECTOR. */
+static void
+name_drop (block_sector_t dir_sector)
+{
+  struct list_elem *e;
+
+  lock_acquire (&name_cache_lock);
+  for (e = list_begin (&name_lru); e != list_end (&name_lru); )
+    {
+      struct name_entry *ne = list_entry (e, struct name_entry, lru_elem);
+      e = list_next (e);
+      if (ne->dir_sector == dir_sector)
+        {
+          list_remove (&ne->lru_elem);
+          hash_delete (&name_cache, &ne->elem);
+          free (ne);
+        }
+    }
+  lock_release (&name_cache_lock);
 }
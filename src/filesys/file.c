@@ -1,9 +1,11 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
-#include "threads/synch.h"
-#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
 
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
@@ -11,21 +13,18 @@
 struct file *
 file_open (struct inode *inode) 
 {
-  lock_acquire(&fs_lock);
   struct file *file = calloc (1, sizeof *file);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
-      lock_release(&fs_lock);
       return file;
     }
   else
     {
       inode_close (inode);
       free (file);
-      lock_release(&fs_lock);
       return NULL; 
     }
 }
@@ -44,11 +43,9 @@ file_close (struct file *file)
 {
   if (file != NULL)
     {
-      lock_acquire(&fs_lock);
       file_allow_write (file);
       inode_close (file->inode);
       free (file); 
-      lock_release(&fs_lock);
     }
 }
 
@@ -80,10 +77,7 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  lock_acquire(&fs_lock);
-  off_t res = inode_read_at (file->inode, buffer, size, file_ofs);
-  lock_release(&fs_lock);
-  return res;
+  return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -112,13 +106,69 @@ off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
-  bool lock_toggle = lock_held_by_current_thread(&fs_lock);
-  if(!lock_toggle)
-    lock_acquire(&fs_lock);
-  off_t res = inode_write_at (file->inode, buffer, size, file_ofs);
-  if(!lock_toggle)
-    lock_release(&fs_lock);
-  return res;
+  return inode_write_at (file->inode, buffer, size, file_ofs);
+}
+
+/* Copies up to SIZE bytes from SRC to DST, starting at each
+   file's current position, and advances both positions by the
+   number of bytes copied.  The data passes through a page-sized
+   kernel buffer, and every read after the first starts on a
+   sector boundary, so that each chunk moves as a run of whole
+   sectors straight to and from the disk.  Returns the number of bytes copied, which may be less
+   than SIZE if end of SRC is reached or DST cannot be written.
+   Returns -1 without copying anything if SRC and DST are the same
+   inode and the two ranges overlap, since the copy would then read
+   back what it had just written. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  off_t bytes_copied = 0;
+  off_t distance;
+  void *buffer;
+
+  ASSERT (dst != NULL && src != NULL);
+  distance = src->pos > dst->pos ? src->pos - dst->pos : dst->pos - src->pos;
+  if (src->inode == dst->inode && size > 0 && distance < size)
+    return -1;
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return 0;
+
+  while (size > 0)
+    {
+      off_t chunk_size = PGSIZE - src->pos % BLOCK_SECTOR_SIZE;
+      off_t bytes_read, bytes_written;
+
+      if (chunk_size > size)
+        chunk_size = size;
+      bytes_read = inode_read_at (src->inode, buffer, chunk_size, src->pos);
+      if (bytes_read == 0)
+        break;
+      bytes_written = inode_write_at (dst->inode, buffer, bytes_read,
+                                      dst->pos);
+      src->pos += bytes_written;
+      dst->pos += bytes_written;
+      bytes_copied += bytes_written;
+      size -= bytes_written;
+      if (bytes_written < bytes_read)
+        break;
+    }
+  palloc_free_page (buffer);
+
+  return bytes_copied;
+}
+
+/* Makes FILE durable: waits until every completed write to it,
+   and the metadata that locates its data, is on disk.  File data
+   is written straight to disk, so only the metadata journal needs
+   committing, and concurrent callers share the commit.  The
+   journal is shared by all files, so this makes every file's
+   completed metadata writes durable, not only FILE's. */
+void
+file_sync (struct file *file)
+{
+  ASSERT (file != NULL);
+  journal_sync ();
 }
 
 /* Prevents write operations on FILE's underlying inode
@@ -5,14 +5,14 @@
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "filesys/directory.h"
-#include "threads/synch.h"
+#include "filesys/sector-pool.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
-struct lock fs_lock;
-
 static void do_format (void);
 
 /* Initializes the file system module.
@@ -23,9 +23,11 @@ filesys_init (bool format)
   fs_device = block_get_role (BLOCK_FILESYS);
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
-  lock_init(&fs_lock);
+  sector_pool_init ();
   inode_init ();
+  dir_init ();
   free_map_init ();
+  journal_init (format);
 
   if (format) 
     do_format ();
@@ -39,8 +41,130 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  journal_flush ();
 }
 
+/* Extracts a file name part from *SRCP into PART, and updates
+   *SRCP so that the next call will return the next file name
+   part.  Returns 1 if successful, 0 at end of string, -1 for a
+   too-long file name part. */
+static int
+get_next_part (char part[NAME_MAX + 1], const char **srcp)
+{
+  const char *src = *srcp;
+  char *dst = part;
+
+  /* Skip leading slashes.  If it's all slashes, we're done. */
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
+
+  /* Copy up to NAME_MAX character from SRC to DST.  Add null
+     terminator. */
+  while (*src != '/' && *src != '\0')
+    {
+      if (dst < part + NAME_MAX)
+        *dst++ = *src;
+      else
+        return -1;
+      src++;
+    }
+  *dst = '\0';
+
+  /* Advance source pointer. */
+  *srcp = src;
+  return 1;
+}
+
+/* Opens the directory that PATH starts from: the root directory
+   for an absolute path, otherwise the current thread's working
+   directory. */
+static struct dir *
+open_start_dir (const char *path)
+{
+  struct dir *cwd = thread_current ()->cwd;
+
+  if (path[0] == '/' || cwd == NULL)
+    return dir_open_root ();
+  return dir_reopen (cwd);
+}
+
+/* Resolves PATH as far as its last component.  Returns the
+   directory that should contain that component, which the
+   caller must close, and copies the component into NAME.  If
+   PATH names the starting directory itself, as "/" does, NAME is
+   the empty string.  Returns a null pointer if PATH is empty, a
+   component is too long, or a directory on the way does not
+   exist. */
+static struct dir *
+resolve (const char *path, char name[NAME_MAX + 1])
+{
+  char part[NAME_MAX + 1];
+  struct dir *dir;
+  int result;
+
+  if (*path == '\0')
+    return NULL;
+  dir = open_start_dir (path);
+  name[0] = '\0';
+  while (dir != NULL && (result = get_next_part (part, &path)) != 0)
+    {
+      struct inode *inode;
+
+      if (result < 0)
+        {
+          dir_close (dir);
+          return NULL;
+        }
+
+      /* Descend into the previous component, which must be a
+         directory since another component follows it. */
+      if (name[0] != '\0')
+        {
+          dir_lookup (dir, name, &inode);
+          dir_close (dir);
+          if (inode != NULL && !inode_is_dir (inode))
+            {
+              inode_close (inode);
+              inode = NULL;
+            }
+          dir = inode != NULL ? dir_open (inode) : NULL;
+        }
+      strlcpy (name, part, NAME_MAX + 1);
+    }
+  return dir;
+}
+
+/* Creates a file or, if IS_DIR, a directory at PATH, with the
+   given INITIAL_SIZE for a file.  Returns true if successful,
+   false otherwise. */
+static bool
+create (const char *path, off_t initial_size, bool is_dir)
+{
+  char name[NAME_MAX + 1];
+  block_sector_t inode_sector = 0;
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = resolve (path, name);
+  success = (dir != NULL
+             && name[0] != '\0'
+             && free_map_allocate (1, &inode_sector)
+             && (is_dir
+                 ? dir_create (inode_sector,
+                               inode_get_inumber (dir_get_inode (dir)), 16)
+                 : inode_create (inode_sector, initial_size, false))
+             && dir_add (dir, name, inode_sector));
+  if (!success && inode_sector != 0) 
+    free_map_release (inode_sector, 1);
+  dir_close (dir);
+  journal_end ();
+
+  return success;
+}
+
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
@@ -48,20 +172,20 @@ filesys_done (void)
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
-  block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
-  if (!success && inode_sector != 0) 
-    free_map_release (inode_sector, 1);
-  dir_close (dir);
+  return create (name, initial_size, false);
+}
 
-  return success;
+/* Creates a directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if a file named NAME already exists,
+   or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name)
+{
+  return create (name, 0, true);
 }
 
-/* Opens the file with the given NAME.
+/* Opens the file or directory with the given NAME.
    Returns the new file if successful or a null pointer
    otherwise.
    Fails if no file named NAME exists,
@@ -69,39 +193,72 @@ filesys_create (const char *name, off_t initial_size)
 struct file *
 filesys_open (const char *name)
 {
-  lock_acquire(&fs_lock);
-  struct dir *dir = dir_open_root ();
+  char part[NAME_MAX + 1];
+  struct dir *dir = resolve (name, part);
   struct inode *inode = NULL;
 
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    {
+      if (part[0] == '\0')
+        inode = inode_reopen (dir_get_inode (dir));
+      else
+        dir_lookup (dir, part, &inode);
+    }
   dir_close (dir);
-  lock_release(&fs_lock);
+
   return file_open (inode);
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file or empty directory named NAME.
    Returns true if successful, false on failure.
    Fails if no file named NAME exists,
    or if an internal memory allocation fails. */
 bool
 filesys_remove (const char *name) 
 {
-  lock_acquire(&fs_lock);
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char part[NAME_MAX + 1];
+  struct dir *dir;
+  bool success;
+
+  journal_begin ();
+  dir = resolve (name, part);
+  success = dir != NULL && dir_remove (dir, part);
   dir_close (dir); 
-  lock_release(&fs_lock);
+  journal_end ();
+
   return success;
 }
-
+
+/* Changes the current thread's working directory to NAME.
+   Returns true if successful, false on failure. */
+bool
+filesys_chdir (const char *name)
+{
+  struct file *file = filesys_open (name);
+  struct thread *t = thread_current ();
+  struct dir *dir;
+
+  if (file == NULL)
+    return false;
+  dir = (inode_is_dir (file_get_inode (file))
+         ? dir_open (inode_reopen (file_get_inode (file)))
+         : NULL);
+  file_close (file);
+  if (dir == NULL)
+    return false;
+
+  dir_close (t->cwd);
+  t->cwd = dir;
+  return true;
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
   free_map_close ();
   printf ("done.\n");
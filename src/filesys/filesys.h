@@ -3,21 +3,24 @@
 
 #include <stdbool.h>
 #include "filesys/off_t.h"
-#include "threads/synch.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
 
+/* First sector of the metadata journal, which occupies
+   JOURNAL_SECTORS sectors. */
+#define JOURNAL_SECTOR 2
+
 /* Block device that contains the file system. */
 extern struct block *fs_device;
 
-struct lock fs_lock;
-
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+bool filesys_mkdir (const char *name);
+bool filesys_chdir (const char *name);
 
 #endif /* filesys/filesys.h */
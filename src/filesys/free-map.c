@@ -1,22 +1,73 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <list.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Released sectors are marked free in the free map file at once,
+   as part of the running transaction, but are not handed out
+   again until that transaction has committed.  Otherwise a file
+   could write data into a reused sector in place, and a crash
+   before the commit would leave the sector's old owner pointing
+   at that data.  So the free map is kept twice: free_map as it is
+   written to disk, and alloc_map, from which sectors are
+   allocated, which also has the bits of released sectors set
+   until their release commits. */
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct bitmap *alloc_map;     /* Free map for allocation. */
+static struct list released;         /* Released runs, oldest first. */
+static struct lock free_map_lock;    /* Protects everything here. */
+
+/* A run of released sectors, waiting for the transaction that
+   released them to commit. */
+struct released_run
+  {
+    struct list_elem elem;           /* Element in `released'. */
+    block_sector_t sector;           /* First sector. */
+    size_t cnt;                      /* Number of sectors. */
+    unsigned transaction;            /* From journal_current(). */
+  };
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
   free_map = bitmap_create (block_size (fs_device));
-  if (free_map == NULL)
+  alloc_map = bitmap_create (block_size (fs_device));
+  if (free_map == NULL || alloc_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
+  list_init (&released);
+  lock_init (&free_map_lock);
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+  bitmap_mark (alloc_map, FREE_MAP_SECTOR);
+  bitmap_mark (alloc_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (alloc_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+}
+
+/* Makes the released runs whose transactions have committed
+   available for allocation.  free_map_lock must be held. */
+static void
+reclaim_released (void)
+{
+  while (!list_empty (&released))
+    {
+      struct released_run *r = list_entry (list_front (&released),
+                                           struct released_run, elem);
+      if (!journal_committed (r->transaction))
+        break;
+      bitmap_set_multiple (alloc_map, r->sector, r->cnt, false);
+      list_pop_front (&released);
+      free (r);
+    }
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,26 +78,55 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  block_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+  reclaim_released ();
+  sector = bitmap_scan_and_flip (alloc_map, 0, cnt, false);
+  if (sector != BITMAP_ERROR)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      if (free_map_file != NULL
+          && !bitmap_write_range (free_map, free_map_file, sector, cnt))
+        {
+          bitmap_set_multiple (free_map, sector, cnt, false);
+          bitmap_set_multiple (alloc_map, sector, cnt, false);
+          sector = BITMAP_ERROR;
+        }
     }
+  lock_release (&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
-/* Makes CNT sectors starting at SECTOR available for use. */
+/* Makes CNT sectors starting at SECTOR available for use, once
+   the running transaction commits.  If there is no memory to
+   remember them until then, they stay in use until the free map
+   is next read from disk. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  journal_forget (sector, cnt);
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  if (free_map_file == NULL)
+    bitmap_set_multiple (alloc_map, sector, cnt, false);
+  else
+    {
+      struct released_run *r = malloc (sizeof *r);
+
+      bitmap_write_range (free_map, free_map_file, sector, cnt);
+      if (r != NULL)
+        {
+          r->sector = sector;
+          r->cnt = cnt;
+          r->transaction = journal_current ();
+          list_push_back (&released, &r->elem);
+        }
+    }
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -56,7 +136,10 @@ free_map_open (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_read (free_map, free_map_file))
+  inode_set_metadata (file_get_inode (free_map_file));
+  ASSERT (list_empty (&released));
+  if (!bitmap_read (free_map, free_map_file)
+      || !bitmap_read (alloc_map, free_map_file))
     PANIC ("can't read free map");
 }
 
@@ -72,14 +155,22 @@ free_map_close (void)
 void
 free_map_create (void) 
 {
+  struct file *file;
+
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
-  /* Write bitmap to file. */
-  free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
-  if (free_map_file == NULL)
+  /* Write bitmap to file.  Writing allocates the file's sectors,
+     which must not try to write the free map file from inside
+     that write, so free_map_file is only set afterward.  The
+     sectors are allocated before any data is copied, so the
+     bitmap written already includes them. */
+  file = file_open (inode_open (FREE_MAP_SECTOR));
+  if (file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
+  inode_set_metadata (file_get_inode (file));
+  if (!bitmap_write (free_map, file))
     PANIC ("can't write free map");
+  free_map_file = file;
 }
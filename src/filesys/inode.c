@@ -1,78 +1,476 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "filesys/sector-pool.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Maximum number of closed inodes kept in memory. */
+#define INODE_CACHE_CNT 64
+
+/* Number of data sector pointers held in the inode itself. */
+#define DIRECT_CNT 122
+
+/* Number of sector pointers in an index block. */
+#define PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Largest number of data sectors an inode can address. */
+#define MAX_SECTORS (DIRECT_CNT + PTRS_PER_SECTOR \
+                     + PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   Data sectors are found through direct pointers, then one
+   indirect and one doubly indirect index block.  A pointer of 0
+   is a hole: it reads as zeros and is allocated by the first
+   write that touches it.  Sector 0 holds the free map's inode, so
+   it is never a data or index sector.  A missing index block is
+   a hole covering every sector it would map. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t sector_cnt;                /* Data and index sectors allocated. */
+    uint32_t is_dir;                    /* 1 for a directory, 0 for a file. */
+    block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+    block_sector_t indirect;            /* Indirect index block. */
+    block_sector_t doubly_indirect;     /* Doubly indirect index block. */
   };
 
-/* Returns the number of sectors to allocate for an inode SIZE
-   bytes long. */
-static inline size_t
-bytes_to_sectors (off_t size)
-{
-  return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
-}
-
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
+    struct list_elem cache_elem;        /* Element in closed_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
-    int open_cnt;                       /* Number of openers. */
+    int open_cnt;                       /* Number of openers, 0 if cached. */
     bool removed;                       /* True if deleted, false otherwise. */
+    bool metadata;                      /* Journal data writes? */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned version;                   /* Changes when the data does. */
+    struct rwlock rw;                   /* Serializes writes with I/O. */
+    struct lock lock;                   /* See inode_lock(). */
     struct inode_disk data;             /* Inode content. */
   };
 
-/* Returns the block device sector that contains byte offset POS
-   within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
-static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+/* Reads SECTOR into BUFFER, taking the journal's copy if it
+   holds one that has not been written home yet.  Used for every
+   sector that may hold metadata. */
+static void
+read_sector (block_sector_t sector, void *buffer)
 {
-  ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+  if (!journal_read (sector, buffer))
+    block_read (fs_device, sector, buffer);
+}
+
+/* State for looking up an inode's sector pointers.  Keeps the
+   most recently used index block at each level in memory, so
+   that walking consecutive sectors reads each index block once.
+   Level 0 is the indirect or doubly indirect block, level 1 a
+   block that the doubly indirect block points to.  The buffer for
+   a level is only taken when the walk first reaches it, so small
+   files, which only use direct pointers, need none. */
+struct index_walk
+  {
+    struct inode *inode;                /* Inode being walked. */
+    block_sector_t sector[2];           /* Index block held at each level. */
+    block_sector_t *ptrs[2];            /* Its contents. */
+    bool dirty[2];                      /* Needs writing back? */
+    bool inode_dirty;                   /* Inode needs writing back? */
+    int level;                          /* Level of last slot returned. */
+    bool out_of_memory;                 /* Failed to get a buffer? */
+  };
+
+/* Starts a walk of INODE's sector pointers. */
+static void
+walk_init (struct index_walk *w, struct inode *inode)
+{
+  w->inode = inode;
+  w->ptrs[0] = w->ptrs[1] = NULL;
+  w->sector[0] = w->sector[1] = 0;
+  w->dirty[0] = w->dirty[1] = false;
+  w->inode_dirty = false;
+  w->out_of_memory = false;
+}
+
+/* Writes back the index block held at LEVEL of W, if modified. */
+static void
+walk_flush (struct index_walk *w, int level)
+{
+  if (w->dirty[level])
+    {
+      journal_write (w->sector[level], w->ptrs[level]);
+      w->dirty[level] = false;
+    }
+}
+
+/* Writes back whatever walk W has modified so far. */
+static void
+walk_sync (struct index_walk *w)
+{
+  walk_flush (w, 0);
+  walk_flush (w, 1);
+  if (w->inode_dirty)
+    {
+      journal_write (w->inode->sector, &w->inode->data);
+      w->inode_dirty = false;
+    }
+}
+
+/* Finishes walk W, writing back whatever it modified. */
+static void
+walk_finish (struct index_walk *w)
+{
+  walk_sync (w);
+  sector_buf_free (w->ptrs[0]);
+  sector_buf_free (w->ptrs[1]);
+}
+
+/* Marks the block at LEVEL of W modified, or the inode if LEVEL
+   is -1. */
+static void
+walk_mark (struct index_walk *w, int level)
+{
+  if (level < 0)
+    w->inode_dirty = true;
   else
-    return -1;
+    w->dirty[level] = true;
+}
+
+/* Makes the index block that *SLOT points to, where SLOT lies at
+   PARENT level, the block held at LEVEL of W.  If *SLOT is a hole
+   and ALLOCATE is true, allocates a new, empty index block for it
+   first.  Returns false if there is no such block, or if no
+   buffer is available to hold it, in which case
+   W->out_of_memory is set. */
+static bool
+walk_child (struct index_walk *w, block_sector_t *slot, int parent,
+            int level, bool allocate)
+{
+  if (*slot == 0 && !allocate)
+    return false;
+  if (w->ptrs[level] == NULL)
+    {
+      w->ptrs[level] = sector_buf_alloc ();
+      if (w->ptrs[level] == NULL)
+        {
+          w->out_of_memory = true;
+          return false;
+        }
+    }
+
+  if (*slot == 0)
+    {
+      block_sector_t sector;
+      if (!free_map_allocate (1, &sector))
+        return false;
+      walk_flush (w, level);
+      memset (w->ptrs[level], 0, BLOCK_SECTOR_SIZE);
+      w->sector[level] = *slot = sector;
+      w->dirty[level] = true;
+      walk_mark (w, parent);
+      w->inode->data.sector_cnt++;
+      w->inode_dirty = true;
+    }
+  else if (w->sector[level] != *slot)
+    {
+      walk_flush (w, level);
+      read_sector (*slot, w->ptrs[level]);
+      w->sector[level] = *slot;
+    }
+  return true;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Returns the slot that holds the sector pointer for data sector
+   IDX of W's inode, and records its level in W->level.  If the
+   index blocks leading to it are missing, allocates them when
+   ALLOCATE is true and otherwise returns a null pointer.  The
+   slot is only valid until the next call. */
+static block_sector_t *
+walk_slot (struct index_walk *w, size_t idx, bool allocate)
+{
+  struct inode_disk *d = &w->inode->data;
+
+  if (idx < DIRECT_CNT)
+    {
+      w->level = -1;
+      return &d->direct[idx];
+    }
+  idx -= DIRECT_CNT;
+
+  if (idx < PTRS_PER_SECTOR)
+    {
+      if (!walk_child (w, &d->indirect, -1, 0, allocate))
+        return NULL;
+      w->level = 0;
+      return &w->ptrs[0][idx];
+    }
+  idx -= PTRS_PER_SECTOR;
+
+  ASSERT (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR);
+  if (!walk_child (w, &d->doubly_indirect, -1, 0, allocate)
+      || !walk_child (w, &w->ptrs[0][idx / PTRS_PER_SECTOR], 0, 1, allocate))
+    return NULL;
+  w->level = 1;
+  return &w->ptrs[1][idx % PTRS_PER_SECTOR];
+}
+
+/* Returns the disk sector holding data sector IDX of W's inode,
+   or 0 if it is a hole or W ran out of memory finding it. */
+static block_sector_t
+walk_lookup (struct index_walk *w, size_t idx)
+{
+  block_sector_t *slot = walk_slot (w, idx, false);
+  return slot != NULL ? *slot : 0;
+}
+
+/* Returns how many of the data sectors of W's inode starting at
+   IDX, up to MAX, are either all holes or consecutive on disk, so
+   that they can be handled with a single multi-sector transfer.
+   Stores the disk sector of the first in *FIRST, or 0 for holes. */
+static size_t
+walk_run (struct index_walk *w, size_t idx, size_t max,
+          block_sector_t *first)
+{
+  size_t cnt;
+
+  *first = walk_lookup (w, idx);
+  for (cnt = 1; cnt < max; cnt++)
+    {
+      block_sector_t sector = walk_lookup (w, idx + cnt);
+      if (*first == 0 ? sector != 0 : sector != *first + cnt)
+        break;
+    }
+  return cnt;
+}
+
+/* Allocates every hole among the CNT data sectors of W's inode
+   starting at IDX, contiguously if the free map allows.  Zeros
+   a newly allocated first sector if ZERO_FIRST and a newly
+   allocated last sector if ZERO_LAST, since those will only be
+   partly overwritten.  Returns false if the disk is full. */
+static bool
+walk_allocate (struct index_walk *w, size_t idx, size_t cnt,
+               bool zero_first, bool zero_last)
+{
+  block_sector_t next = 0;
+  size_t holes = 0, i;
+  bool success = true;
+
+  for (i = 0; i < cnt; i++)
+    if (walk_lookup (w, idx + i) == 0)
+      holes++;
+  if (holes == 0)
+    return true;
+  if (!free_map_allocate (holes, &next))
+    next = 0;
+
+  for (i = 0; i < cnt; i++)
+    {
+      block_sector_t *slot = walk_slot (w, idx + i, true);
+      if (slot == NULL)
+        {
+          success = false;
+          break;
+        }
+      if (*slot != 0)
+        continue;
+
+      if (next != 0)
+        {
+          *slot = next++;
+          holes--;
+        }
+      else if (!free_map_allocate (1, slot))
+        {
+          success = false;
+          break;
+        }
+      walk_mark (w, w->level);
+      w->inode->data.sector_cnt++;
+      w->inode_dirty = true;
+      if ((i == 0 && zero_first) || (i == cnt - 1 && zero_last))
+        block_write_zeros (fs_device, *slot, 1);
+    }
+
+  /* Return whatever part of a contiguous allocation went unused. */
+  if (next != 0 && holes > 0)
+    free_map_release (next, holes);
+  return success;
+}
+
+/* Releases every sector reachable from index block SECTOR, which
+   is DEPTH levels above the data, and the block itself. */
+static void
+release_index (block_sector_t sector, int depth)
+{
+  block_sector_t *ptrs;
+  size_t i;
+
+  if (sector == 0)
+    return;
+  ptrs = sector_buf_alloc ();
+  if (ptrs == NULL)
+    PANIC ("out of memory releasing inode blocks");
+  read_sector (sector, ptrs);
+  for (i = 0; i < PTRS_PER_SECTOR; i++)
+    if (ptrs[i] != 0)
+      {
+        if (depth > 1)
+          release_index (ptrs[i], depth - 1);
+        else
+          free_map_release (ptrs[i], 1);
+      }
+  sector_buf_free (ptrs);
+  free_map_release (sector, 1);
+}
+
+/* Releases all data and index sectors of disk inode D. */
+static void
+release_blocks (const struct inode_disk *d)
+{
+  block_sector_t run_start = 0;
+  size_t run_cnt = 0;
+  size_t i;
+
+  /* Direct sectors are usually contiguous, so release them in
+     runs. */
+  for (i = 0; i < DIRECT_CNT; i++)
+    {
+      block_sector_t sector = d->direct[i];
+      if (run_cnt > 0 && sector == run_start + run_cnt)
+        run_cnt++;
+      else
+        {
+          if (run_cnt > 0)
+            free_map_release (run_start, run_cnt);
+          run_start = sector;
+          run_cnt = sector != 0;
+        }
+    }
+  if (run_cnt > 0)
+    free_map_release (run_start, run_cnt);
+
+  release_index (d->indirect, 1);
+  release_index (d->doubly_indirect, 2);
+}
+
+/* Open inodes, indexed by sector, so that opening a single
+   inode twice returns the same `struct inode'.  Also contains the
+   inodes in closed_inodes. */
+static struct hash open_inodes;
+
+/* Inodes that have been closed by their last opener but are kept
+   in memory, with their `inode_disk', so that reopening them
+   doesn't read the disk.  Least recently closed first. */
+static struct list closed_inodes;
+static size_t closed_cnt;
+
+/* Protects open_inodes, closed_inodes, and open counts. */
+static struct lock open_inodes_lock;
+
+/* Last version number given to an inode, and its lock. */
+static unsigned version_cnt;
+static struct lock version_lock;
+
+/* Gives INODE a version number that no inode has had before, so
+   that anything cached about its old contents is seen to be
+   stale. */
+static void
+new_version (struct inode *inode)
+{
+  lock_acquire (&version_lock);
+  inode->version = ++version_cnt;
+  lock_release (&version_lock);
+}
+
+/* Returns a hash value for inode E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->sector);
+}
+
+/* Returns true if inode A's sector precedes inode B's. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
+
+/* Returns the in-memory inode for SECTOR, or a null pointer if
+   there is none.  Must be called with open_inodes_lock held. */
+static struct inode *
+find_inode (block_sector_t sector)
+{
+  struct inode key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  return e != NULL ? hash_entry (e, struct inode, elem) : NULL;
+}
+
+/* Forgets INODE, which must be cached, and frees it.
+   Must be called with open_inodes_lock held. */
+static void
+evict_inode (struct inode *inode)
+{
+  ASSERT (inode->open_cnt == 0);
+  list_remove (&inode->cache_elem);
+  closed_cnt--;
+  hash_delete (&open_inodes, &inode->elem);
+  free (inode);
+}
+
+/* Adds an opener to INODE, taking it out of the cache of closed
+   inodes if it was there.
+   Must be called with open_inodes_lock held. */
+static void
+reopen_locked (struct inode *inode)
+{
+  if (inode->open_cnt++ == 0)
+    {
+      list_remove (&inode->cache_elem);
+      closed_cnt--;
+    }
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  list_init (&closed_inodes);
+  lock_init (&open_inodes_lock);
+  lock_init (&version_lock);
 }
 
-/* Initializes an inode with LENGTH bytes of data and
+/* Initializes an inode with LENGTH bytes of data, for a
+   directory if IS_DIR is true or a file otherwise, and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The data starts out as one big hole, so no data
+   sectors are allocated or written until they are first written.
    Returns true if successful.
-   Returns false if memory or disk allocation fails. */
+   Returns false if memory allocation fails. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool is_dir)
 {
   struct inode_disk *disk_inode = NULL;
+  struct inode *stale;
   bool success = false;
 
   ASSERT (length >= 0);
@@ -81,26 +479,26 @@ inode_create (block_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
-  disk_inode = calloc (1, sizeof *disk_inode);
+  if (DIV_ROUND_UP (length, BLOCK_SECTOR_SIZE) > (off_t) MAX_SECTORS)
+    return false;
+
+  /* Any cached copy of an inode formerly in SECTOR is stale. */
+  lock_acquire (&open_inodes_lock);
+  stale = find_inode (sector);
+  if (stale != NULL && stale->open_cnt == 0)
+    evict_inode (stale);
+  lock_release (&open_inodes_lock);
+
+  disk_inode = sector_buf_alloc ();
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
+      memset (disk_inode, 0, sizeof *disk_inode);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
-      free (disk_inode);
+      disk_inode->is_dir = is_dir;
+      journal_write (sector, disk_inode);
+      success = true; 
+      sector_buf_free (disk_inode);
     }
   return success;
 }
@@ -111,33 +509,48 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *other;
 
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  /* Check whether this inode is already open or cached. */
+  lock_acquire (&open_inodes_lock);
+  inode = find_inode (sector);
+  if (inode != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      reopen_locked (inode);
+      lock_release (&open_inodes_lock);
+      return inode;
     }
+  lock_release (&open_inodes_lock);
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize, reading the disk without holding
+     open_inodes_lock so that other opens and closes proceed. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->metadata = false;
+  new_version (inode);
+  rwlock_init (&inode->rw);
+  lock_init (&inode->lock);
+  read_sector (inode->sector, &inode->data);
+
+  /* Another thread may have opened the inode meanwhile. */
+  lock_acquire (&open_inodes_lock);
+  other = find_inode (sector);
+  if (other != NULL)
+    {
+      reopen_locked (other);
+      lock_release (&open_inodes_lock);
+      free (inode);
+      return other;
+    }
+  hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +559,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -157,9 +574,20 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns INODE's version number.  The same inode number and
+   version mean the same data, for as long as the inode stays in
+   memory; a write, or reading the inode in again, gives it a new
+   version. */
+unsigned
+inode_get_version (const struct inode *inode)
+{
+  return inode->version;
+}
+
 /* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
-   If INODE was also a removed inode, frees its blocks. */
+   If this was the last reference to INODE, moves it to the cache
+   of closed inodes, or frees its memory and blocks if INODE was
+   also a removed inode. */
 void
 inode_close (struct inode *inode) 
 {
@@ -167,22 +595,34 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt > 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
-      if (inode->removed) 
-        {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
-        }
+      lock_release (&open_inodes_lock);
+      return;
+    }
 
-      free (inode); 
+  /* This was the last opener.  Keep the inode cached unless it
+     was removed. */
+  if (!inode->removed)
+    {
+      list_push_back (&closed_inodes, &inode->cache_elem);
+      if (++closed_cnt > INODE_CACHE_CNT)
+        evict_inode (list_entry (list_front (&closed_inodes),
+                                 struct inode, cache_elem));
+      lock_release (&open_inodes_lock);
+      return;
     }
+
+  /* Release resources: remove from the table, then deallocate
+     blocks. */
+  hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+  journal_begin ();
+  free_map_release (inode->sector, 1);
+  release_blocks (&inode->data);
+  journal_end ();
+  free (inode); 
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -194,21 +634,42 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Returns true if INODE has been removed. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
+/* Marks INODE as holding file system metadata, such as a
+   directory or the free map, so that writes to its data go
+   through the journal like writes to the inode itself. */
+void
+inode_set_metadata (struct inode *inode)
+{
+  inode->metadata = true;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
+   than SIZE if an error occurs or end of file is reached.  Holes
+   read as zeros without touching the disk. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
+  struct index_walk w;
 
+  walk_init (&w, inode);
+  rwlock_acquire_read (&inode->rw);
   while (size > 0) 
     {
-      /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Data sector to read, starting byte offset within sector. */
+      size_t idx = offset / BLOCK_SECTOR_SIZE;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      block_sector_t sector_idx;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
       off_t inode_left = inode_length (inode) - offset;
@@ -222,8 +683,37 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          /* Read full sectors directly into caller's buffer.
+             Metadata may be in the journal, so it is read one
+             sector at a time. */
+          off_t left = size < inode_left ? size : inode_left;
+          size_t cnt = walk_run (&w, idx, (inode->metadata ? 1
+                                           : left / BLOCK_SECTOR_SIZE),
+                                 &sector_idx);
+          if (w.out_of_memory)
+            break;
+          chunk_size = cnt * BLOCK_SECTOR_SIZE;
+          if (sector_idx == 0)
+            memset (buffer + bytes_read, 0, chunk_size);
+          else if (inode->metadata)
+            read_sector (sector_idx, buffer + bytes_read);
+          else
+            block_read_multi (fs_device, sector_idx, cnt,
+                              buffer + bytes_read);
+        }
+      else if ((sector_idx = walk_lookup (&w, idx)) == 0)
+        {
+          if (w.out_of_memory)
+            break;
+          memset (buffer + bytes_read, 0, chunk_size);
+        }
+      else if (size >= BLOCK_SECTOR_SIZE)
+        {
+          /* The caller's buffer has room for the whole sector:
+             read it there and slide the wanted part down. */
+          read_sector (sector_idx, buffer + bytes_read);
+          memmove (buffer + bytes_read, buffer + bytes_read + sector_ofs,
+                   chunk_size);
         }
       else 
         {
@@ -231,11 +721,11 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
              into caller's buffer. */
           if (bounce == NULL) 
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
+              bounce = sector_buf_alloc ();
               if (bounce == NULL)
                 break;
             }
-          block_read (fs_device, sector_idx, bounce);
+          read_sector (sector_idx, bounce);
           memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         }
       
@@ -244,67 +734,92 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  walk_finish (&w);
+  rwlock_release_read (&inode->rw);
+  sector_buf_free (bounce);
 
   return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
-   Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
-off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
-                off_t offset) 
+/* Data sectors that one journal operation of inode_write_at()
+   allocates and writes, so that the index blocks and free map
+   sectors it changes fit in the operation's reservation.
+   Metadata inodes journal their data as well, so they go a few
+   sectors at a time. */
+#define WRITE_OP_SECTORS 1024
+#define METADATA_WRITE_OP_SECTORS 8
+
+/* Writes SIZE bytes from BUFFER into W's inode, starting at
+   OFFSET, which must all lie within the inode, allocating any
+   holes in the range first.  Uses *BOUNCE as a bounce buffer,
+   allocating it if it is null.  Returns the number of bytes
+   written. */
+static off_t
+write_piece (struct index_walk *w, const uint8_t *buffer, off_t size,
+             off_t offset, uint8_t **bounce)
 {
-  const uint8_t *buffer = buffer_;
+  struct inode *inode = w->inode;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
-
-  if (inode->deny_write_cnt)
+  off_t end = offset + size;
+
+  /* Allocate the sectors being written. */
+  if (!walk_allocate (w, offset / BLOCK_SECTOR_SIZE,
+                      DIV_ROUND_UP (end, BLOCK_SECTOR_SIZE)
+                      - offset / BLOCK_SECTOR_SIZE,
+                      offset % BLOCK_SECTOR_SIZE != 0,
+                      end % BLOCK_SECTOR_SIZE != 0))
     return 0;
 
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      size_t idx = offset / BLOCK_SECTOR_SIZE;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      block_sector_t sector_idx;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Bytes left in sector, lesser of it and bytes to write. */
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
-
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+      int chunk_size = size < sector_left ? size : sector_left;
 
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          /* Write full sectors directly to disk, or metadata
+             one sector at a time to the journal. */
+          size_t cnt = walk_run (w, idx, (inode->metadata ? 1
+                                          : size / BLOCK_SECTOR_SIZE),
+                                 &sector_idx);
+          ASSERT (sector_idx != 0);
+          if (inode->metadata)
+            journal_write (sector_idx, buffer + bytes_written);
+          else
+            block_write_multi (fs_device, sector_idx, cnt,
+                               buffer + bytes_written);
+          chunk_size = cnt * BLOCK_SECTOR_SIZE;
         }
       else 
         {
           /* We need a bounce buffer. */
-          if (bounce == NULL) 
+          if (*bounce == NULL) 
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
+              *bounce = sector_buf_alloc ();
+              if (*bounce == NULL)
                 break;
             }
 
           /* If the sector contains data before or after the chunk
              we're writing, then we need to read in the sector
              first.  Otherwise we start with a sector of all zeros. */
+          sector_idx = walk_lookup (w, idx);
+          ASSERT (sector_idx != 0);
           if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
+            read_sector (sector_idx, *bounce);
           else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+            memset (*bounce, 0, BLOCK_SECTOR_SIZE);
+          memcpy (*bounce + sector_ofs, buffer + bytes_written, chunk_size);
+          if (inode->metadata)
+            journal_write (sector_idx, *bounce);
+          else
+            block_write (fs_device, sector_idx, *bounce);
         }
 
       /* Advance. */
@@ -312,18 +827,118 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
+  return bytes_written;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if end of file is reached or an error occurs.
+   (Normally a write at end of file would extend the inode, but
+   growth is not yet implemented.)  Allocates any holes in the
+   range first.  A large write is split into several journal
+   operations, each of which allocates and writes part of the
+   range, so a crash may leave only a prefix of it in place. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+                off_t offset) 
+{
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+  off_t op_bytes = (inode->metadata ? METADATA_WRITE_OP_SECTORS
+                    : WRITE_OP_SECTORS) * BLOCK_SECTOR_SIZE;
+  uint8_t *bounce = NULL;
+  struct index_walk w;
+
+  walk_init (&w, inode);
+  rwlock_acquire_write (&inode->rw);
+  if (inode->deny_write_cnt)
+    {
+      rwlock_release_write (&inode->rw);
+      walk_finish (&w);
+      return 0;
+    }
+
+  if (size > inode_length (inode) - offset)
+    size = inode_length (inode) - offset;
+  while (size > 0)
+    {
+      off_t piece = op_bytes - offset % op_bytes;
+      off_t written;
+
+      if (piece > size)
+        piece = size;
+      journal_begin ();
+      written = write_piece (&w, buffer + bytes_written, piece, offset,
+                             &bounce);
+      walk_sync (&w);
+      journal_end ();
+
+      size -= written;
+      offset += written;
+      bytes_written += written;
+      if (written < piece)
+        break;
+    }
+  walk_finish (&w);
+  if (bytes_written > 0)
+    new_version (inode);
+  rwlock_release_write (&inode->rw);
+  sector_buf_free (bounce);
 
   return bytes_written;
 }
 
+/* Exchanges the data of inodes A and B, which must be distinct,
+   and writes both back to disk.  Each inode keeps its own sector,
+   so openers of A see B's former contents and vice versa.  Used to
+   replace a directory's contents in one step after rebuilding it
+   in a scratch inode. */
+void
+inode_swap_data (struct inode *a, struct inode *b)
+{
+  struct inode_disk tmp;
+
+  ASSERT (a != NULL && b != NULL && a != b);
+
+  rwlock_acquire_write (&a->rw);
+  rwlock_acquire_write (&b->rw);
+  tmp = a->data;
+  a->data = b->data;
+  b->data = tmp;
+  journal_write (a->sector, &a->data);
+  journal_write (b->sector, &b->data);
+  new_version (a);
+  new_version (b);
+  rwlock_release_write (&b->rw);
+  rwlock_release_write (&a->rw);
+}
+
+/* Acquires INODE's lock.  Reads and writes of INODE's data
+   synchronize themselves; this lock is for layers above, such as
+   directories, that need a sequence of reads and writes to appear
+   atomic. */
+void
+inode_lock (struct inode *inode)
+{
+  lock_acquire (&inode->lock);
+}
+
+/* Releases INODE's lock, which the current thread must hold. */
+void
+inode_unlock (struct inode *inode)
+{
+  lock_release (&inode->lock);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rw);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_release_write (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +947,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rw);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_release_write (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +960,19 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Returns the number of data and index sectors allocated to
+   INODE, which for a sparse file is less than its length in
+   sectors. */
+size_t
+inode_sector_cnt (const struct inode *inode)
+{
+  return inode->data.sector_cnt;
+}
+
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return inode->data.is_dir;
+}
@@ -0,0 +1,497 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Metadata redo journal.
+
+   Writes of metadata sectors--inodes, index blocks, directory
+   data, and the free map--are not written in place.  Instead the
+   journal keeps the latest copy of each in memory as part of the
+   running transaction, so that a sector rewritten many times,
+   such as a free map sector during a run of creates, costs only
+   one write per transaction.
+
+   A commit writes the transaction's sectors and a header listing
+   their home locations to the log area in a single sequential
+   transfer, then writes each sector home, then marks the log
+   clean.  If the system stops before the log is marked clean,
+   journal_init() copies the logged sectors home again on the
+   next boot, so metadata is always either wholly before or wholly
+   after a transaction.  The header carries a checksum of the
+   logged sectors, so a log write cut short is ignored.
+
+   File system operations bracket their metadata writes with
+   journal_begin() and journal_end().  Transactions are committed
+   between operations, once enough sectors accumulate or
+   periodically.  Each operation reserves room for
+   JOURNAL_OP_SECTORS sectors when it begins, and new operations
+   wait while the running transaction is past its high-water mark
+   or could not hold them, so the transaction fills up only at an
+   operation boundary, once the operations in it have drained.
+   journal_flush() likewise holds off new operations and waits for
+   those in progress to end before it commits.  Callers keep each
+   operation within its reservation, splitting large writes into
+   several operations, so a transaction is never committed in the
+   middle of one.
+
+   journal_sync() makes everything written so far durable.  Syncs
+   requested while a sync commit is under way are served together
+   by the next commit, so N processes calling fsync() at once cost
+   about two commits rather than N. */
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Commit once this many sectors are pending. */
+#define JOURNAL_HIGH_WATER (JOURNAL_CAPACITY * 3 / 4)
+
+/* Sectors reserved for each operation in progress: a few free map
+   sectors, inodes, index blocks and directory blocks.  No
+   operation may log more distinct sectors than this. */
+#define JOURNAL_OP_SECTORS 16
+
+/* Commit pending sectors at least this often, in timer ticks. */
+#define JOURNAL_INTERVAL TIMER_FREQ
+
+/* Pages holding the log image: header, then the sectors. */
+#define JOURNAL_PAGES DIV_ROUND_UP (JOURNAL_SECTORS * BLOCK_SECTOR_SIZE, \
+                                    PGSIZE)
+
+/* Journal header, in the first sector of the log area.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t cnt;                       /* Sectors logged, 0 if clean. */
+    unsigned checksum;                  /* hash_bytes() of those sectors. */
+    block_sector_t home[JOURNAL_CAPACITY]; /* Where each belongs. */
+  };
+
+/* A sector in the running transaction.  Entry I's data is in
+   slot I of the log image. */
+struct journal_entry
+  {
+    struct hash_elem elem;              /* Element in `pending'. */
+    block_sector_t sector;              /* Home sector. */
+  };
+
+/* The log image: header followed by one slot per entry, laid out
+   exactly as it is written to the log area. */
+static struct journal_header *header;
+static uint8_t *slots;
+
+static struct journal_entry entries[JOURNAL_CAPACITY];
+static size_t entry_cnt;                /* Entries in use. */
+static struct hash pending;             /* Entries, by sector. */
+static int active_cnt;                  /* Operations in progress. */
+static unsigned commit_seq;             /* Numbers the running transaction. */
+static struct condition room;           /* Signaled when one may begin. */
+static int flush_cnt;                   /* journal_flush() calls waiting. */
+static struct condition idle;           /* Signaled when none in progress. */
+static struct lock journal_lock;        /* Protects everything here. */
+
+/* Group commit for journal_sync().  Each request takes a ticket;
+   a commit started after ticket T was taken covers every request
+   up to T. */
+static struct lock sync_lock;           /* Protects the following. */
+static struct condition sync_done;      /* Signaled when a sync ends. */
+static unsigned sync_ticket;            /* Last ticket handed out. */
+static unsigned sync_covered;           /* Tickets known durable. */
+static bool sync_leader;                /* Sync commit under way? */
+
+/* Statistics. */
+static long long commit_cnt;            /* Transactions committed. */
+static long long logged_cnt;            /* Sectors logged. */
+static long long absorbed_cnt;          /* Rewrites of a pending sector. */
+static long long sync_cnt;              /* Calls to journal_sync(). */
+static long long sync_commit_cnt;       /* Commits made for them. */
+
+static void commit (void);
+static void journal_daemon (void *aux);
+
+/* Returns the data of entry E. */
+static uint8_t *
+entry_data (const struct journal_entry *e)
+{
+  return slots + (e - entries) * BLOCK_SECTOR_SIZE;
+}
+
+/* Returns a hash value for journal_entry E. */
+static unsigned
+entry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct journal_entry, elem)->sector);
+}
+
+/* Returns true if journal_entry A's sector precedes B's. */
+static bool
+entry_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct journal_entry, elem)->sector
+          < hash_entry (b, struct journal_entry, elem)->sector);
+}
+
+/* Returns the pending entry for SECTOR, or a null pointer if
+   there is none.  Must be called with journal_lock held. */
+static struct journal_entry *
+find_entry (block_sector_t sector)
+{
+  struct journal_entry key;
+  struct hash_elem *e;
+
+  if (entry_cnt == 0)
+    return NULL;
+  key.sector = sector;
+  e = hash_find (&pending, &key.elem);
+  return e != NULL ? hash_entry (e, struct journal_entry, elem) : NULL;
+}
+
+/* Initializes the journal.  If FORMAT is true, writes an empty
+   journal; otherwise, finishes any transaction that was committed
+   but not completed before the system stopped.  Must be called
+   before anything reads file system metadata. */
+void
+journal_init (bool format)
+{
+  ASSERT (sizeof *header == BLOCK_SECTOR_SIZE);
+
+  header = palloc_get_multiple (PAL_ASSERT, JOURNAL_PAGES);
+  slots = (uint8_t *) header + BLOCK_SECTOR_SIZE;
+  hash_init (&pending, entry_hash, entry_less, NULL);
+  lock_init (&journal_lock);
+  cond_init (&room);
+  cond_init (&idle);
+  lock_init (&sync_lock);
+  cond_init (&sync_done);
+  entry_cnt = 0;
+  active_cnt = 0;
+  flush_cnt = 0;
+
+  if (!format)
+    {
+      block_read (fs_device, JOURNAL_SECTOR, header);
+      if (header->magic != JOURNAL_MAGIC)
+        PANIC ("no journal found--reformat the file system");
+      if (header->cnt > 0 && header->cnt <= JOURNAL_CAPACITY)
+        {
+          size_t cnt = header->cnt;
+          size_t i;
+
+          block_read_multi (fs_device, JOURNAL_SECTOR + 1, cnt, slots);
+          if (hash_bytes (slots, cnt * BLOCK_SECTOR_SIZE)
+              == header->checksum)
+            {
+              for (i = 0; i < cnt; i++)
+                block_write (fs_device, header->home[i],
+                             slots + i * BLOCK_SECTOR_SIZE);
+              printf ("journal: replayed %zu sectors\n", cnt);
+            }
+          else
+            printf ("journal: discarded incomplete transaction\n");
+        }
+    }
+
+  memset (header, 0, BLOCK_SECTOR_SIZE);
+  header->magic = JOURNAL_MAGIC;
+  block_write (fs_device, JOURNAL_SECTOR, header);
+
+  thread_create ("journal", PRI_DEFAULT, journal_daemon, NULL);
+}
+
+/* Returns true if the running transaction has room for another
+   operation.  Must be called with journal_lock held. */
+static bool
+has_room (void)
+{
+  return (entry_cnt < JOURNAL_HIGH_WATER
+          && (entry_cnt + (active_cnt + 1) * JOURNAL_OP_SECTORS
+              <= JOURNAL_CAPACITY));
+}
+
+/* Starts an operation whose metadata writes should be committed
+   together, first waiting until the running transaction has room
+   for it and no flush is pending.  Operations may nest; only the
+   outermost one counts. */
+void
+journal_begin (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+  lock_acquire (&journal_lock);
+  while (flush_cnt > 0 || !has_room ())
+    if (flush_cnt == 0 && active_cnt == 0)
+      commit ();
+    else
+      cond_wait (&room, &journal_lock);
+  active_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation started with journal_begin().  Once no
+   operation is in progress, wakes a pending flush, or else commits
+   the running transaction if it is large or has no room for the
+   operations waiting to begin. */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+  lock_acquire (&journal_lock);
+  ASSERT (active_cnt > 0);
+  if (--active_cnt == 0)
+    {
+      if (flush_cnt > 0)
+        cond_broadcast (&idle, &journal_lock);
+      else if (!has_room ())
+        commit ();
+    }
+  cond_broadcast (&room, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Writes BUFFER, which must be BLOCK_SECTOR_SIZE bytes, as the
+   new contents of metadata SECTOR.  The sector reaches the disk
+   when the running transaction commits; until then,
+   journal_read() returns it. */
+void
+journal_write (block_sector_t sector, const void *buffer)
+{
+  struct journal_entry *e;
+
+  lock_acquire (&journal_lock);
+  e = find_entry (sector);
+  if (e != NULL)
+    absorbed_cnt++;
+  else
+    {
+      /* Operations stay within their reservations, so only a
+         write outside any operation, while formatting, can find
+         the log full. */
+      if (entry_cnt == JOURNAL_CAPACITY)
+        {
+          if (active_cnt > 0)
+            PANIC ("journal: operation overflowed the log");
+          commit ();
+        }
+      e = &entries[entry_cnt++];
+      e->sector = sector;
+      hash_insert (&pending, &e->elem);
+    }
+  memcpy (entry_data (e), buffer, BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+}
+
+/* If the running transaction holds SECTOR, copies it into BUFFER
+   and returns true.  Otherwise returns false, and the sector
+   should be read from disk. */
+bool
+journal_read (block_sector_t sector, void *buffer)
+{
+  struct journal_entry *e;
+
+  lock_acquire (&journal_lock);
+  e = find_entry (sector);
+  if (e != NULL)
+    memcpy (buffer, entry_data (e), BLOCK_SECTOR_SIZE);
+  lock_release (&journal_lock);
+  return e != NULL;
+}
+
+/* Drops any pending writes to the CNT sectors starting at SECTOR,
+   which are being freed.  Otherwise committing could overwrite
+   whatever they are reused for. */
+void
+journal_forget (block_sector_t sector, size_t cnt)
+{
+  size_t i;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < cnt && entry_cnt > 0; i++)
+    {
+      struct journal_entry *e = find_entry (sector + i);
+      struct journal_entry *last;
+      if (e == NULL)
+        continue;
+
+      /* Keep entries dense by moving the last one into E. */
+      hash_delete (&pending, &e->elem);
+      last = &entries[--entry_cnt];
+      if (e != last)
+        {
+          hash_delete (&pending, &last->elem);
+          e->sector = last->sector;
+          memcpy (entry_data (e), entry_data (last), BLOCK_SECTOR_SIZE);
+          hash_insert (&pending, &e->elem);
+        }
+    }
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction, if any, once the operations in
+   progress have ended, so that none of them is committed half
+   done.  New operations wait meanwhile, so the flush cannot be
+   starved.  Must not be called inside an operation. */
+void
+journal_flush (void)
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  flush_cnt++;
+  while (active_cnt > 0)
+    cond_wait (&idle, &journal_lock);
+  commit ();
+  flush_cnt--;
+  cond_broadcast (&room, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Commits every metadata write made before the call, waiting
+   until it is on disk.  Concurrent callers share commits: whoever
+   finds no sync commit under way makes one on behalf of every
+   caller waiting so far, and later arrivals wait for it to finish
+   and then batch into the next. */
+void
+journal_sync (void)
+{
+  unsigned ticket;
+
+  lock_acquire (&sync_lock);
+  sync_cnt++;
+  ticket = ++sync_ticket;
+  while ((int) (sync_covered - ticket) < 0)
+    if (sync_leader)
+      cond_wait (&sync_done, &sync_lock);
+    else
+      {
+        unsigned covered = sync_ticket;
+
+        sync_leader = true;
+        sync_commit_cnt++;
+        lock_release (&sync_lock);
+        journal_flush ();
+        lock_acquire (&sync_lock);
+        sync_leader = false;
+        sync_covered = covered;
+        cond_broadcast (&sync_done, &sync_lock);
+      }
+  lock_release (&sync_lock);
+}
+
+/* Returns a number identifying the running transaction, to pass
+   to journal_committed(). */
+unsigned
+journal_current (void)
+{
+  unsigned transaction;
+
+  lock_acquire (&journal_lock);
+  transaction = commit_seq;
+  lock_release (&journal_lock);
+  return transaction;
+}
+
+/* Returns true if TRANSACTION, obtained from journal_current(),
+   has been committed. */
+bool
+journal_committed (unsigned transaction)
+{
+  bool committed;
+
+  lock_acquire (&journal_lock);
+  committed = (int) (commit_seq - transaction) > 0;
+  lock_release (&journal_lock);
+  return committed;
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void)
+{
+  printf ("Journal: %lld commits, %lld sectors logged, "
+          "%lld rewrites absorbed, %lld syncs in %lld commits\n",
+          commit_cnt, logged_cnt, absorbed_cnt, sync_cnt, sync_commit_cnt);
+}
+
+/* Compares the home sectors of the entries that A and B point
+   to, for qsort(). */
+static int
+compare_entries (const void *a_, const void *b_)
+{
+  const struct journal_entry *a = *(struct journal_entry *const *) a_;
+  const struct journal_entry *b = *(struct journal_entry *const *) b_;
+  return a->sector < b->sector ? -1 : a->sector > b->sector;
+}
+
+/* Writes the running transaction to the log, then home, then
+   marks the log clean and starts a new transaction.
+   Must be called with journal_lock held. */
+static void
+commit (void)
+{
+  struct journal_entry *order[JOURNAL_CAPACITY];
+  size_t i;
+
+  if (entry_cnt == 0)
+    return;
+
+  /* Log the transaction in one transfer. */
+  header->cnt = entry_cnt;
+  header->checksum = hash_bytes (slots, entry_cnt * BLOCK_SECTOR_SIZE);
+  for (i = 0; i < entry_cnt; i++)
+    {
+      header->home[i] = entries[i].sector;
+      order[i] = &entries[i];
+    }
+  block_write_multi (fs_device, JOURNAL_SECTOR, entry_cnt + 1, header);
+
+  /* Write each sector home, in disk order. */
+  qsort (order, entry_cnt, sizeof *order, compare_entries);
+  for (i = 0; i < entry_cnt; i++)
+    block_write (fs_device, order[i]->sector, entry_data (order[i]));
+
+  header->cnt = 0;
+  block_write (fs_device, JOURNAL_SECTOR, header);
+
+  commit_seq++;
+  commit_cnt++;
+  logged_cnt += entry_cnt;
+  hash_clear (&pending, NULL);
+  entry_cnt = 0;
+}
+
+/* Thread that commits pending sectors every JOURNAL_INTERVAL
+   ticks, so that they do not wait in memory indefinitely while
+   the file system is idle. */
+static void
+journal_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (JOURNAL_INTERVAL);
+      lock_acquire (&journal_lock);
+      if (active_cnt == 0)
+        {
+          commit ();
+          cond_broadcast (&room, &journal_lock);
+        }
+      lock_release (&journal_lock);
+    }
+}
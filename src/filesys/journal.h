@@ -0,0 +1,27 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Most sectors that one transaction can log. */
+#define JOURNAL_CAPACITY 125
+
+/* Sectors the journal occupies, starting at JOURNAL_SECTOR: a
+   header followed by room for a full transaction. */
+#define JOURNAL_SECTORS (1 + JOURNAL_CAPACITY)
+
+void journal_init (bool format);
+void journal_begin (void);
+void journal_end (void);
+void journal_write (block_sector_t, const void *);
+bool journal_read (block_sector_t, void *);
+void journal_forget (block_sector_t, size_t cnt);
+void journal_flush (void);
+void journal_sync (void);
+unsigned journal_current (void);
+bool journal_committed (unsigned transaction);
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,126 @@
+#include "filesys/sector-pool.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Pool of sector-sized scratch buffers.
+
+   The file system needs a BLOCK_SECTOR_SIZE bounce buffer
+   whenever it reads or writes part of a sector.  Rather than
+   going through malloc() for each one, buffers are carved out of
+   whole pages and kept on a free list once released.  Pages are
+   never returned to the page allocator, so the pool only ever
+   grows to the peak number of buffers in use at once.
+
+   Taking or returning a buffer is a few pointer moves, so the
+   free list is protected by turning interrupts off rather than
+   by a lock that threads would queue on.  Only refilling, which
+   calls into the page allocator, runs with interrupts on. */
+
+/* A free buffer.  The link is stored in the buffer itself. */
+struct free_buf
+  {
+    struct free_buf *next;
+  };
+
+#define BUFS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+static struct free_buf *free_bufs;  /* Free list. */
+
+/* Statistics.  Each allocation served is a malloc() and free()
+   of a sector buffer that no longer happens. */
+static long long alloc_cnt;         /* Calls to sector_buf_alloc(). */
+static long long page_cnt;          /* Pages taken from palloc. */
+static int in_use_cnt;              /* Buffers allocated now. */
+static int peak_cnt;                /* Most ever allocated at once. */
+
+/* Initializes the sector buffer pool. */
+void
+sector_pool_init (void)
+{
+  free_bufs = NULL;
+}
+
+/* Adds a fresh page's worth of buffers to the free list.
+   Returns false if no page is available. */
+static bool
+refill (void)
+{
+  uint8_t *page = palloc_get_page (0);
+  enum intr_level old_level;
+  size_t i;
+
+  if (page == NULL)
+    return false;
+  old_level = intr_disable ();
+  for (i = 0; i < BUFS_PER_PAGE; i++)
+    {
+      struct free_buf *b = (struct free_buf *) (page + i * BLOCK_SECTOR_SIZE);
+      b->next = free_bufs;
+      free_bufs = b;
+    }
+  page_cnt++;
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Returns a BLOCK_SECTOR_SIZE buffer with unspecified contents,
+   or a null pointer if memory is exhausted. */
+void *
+sector_buf_alloc (void)
+{
+  enum intr_level old_level;
+  struct free_buf *b;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  while (free_bufs == NULL)
+    {
+      /* Another thread may take the new buffers before we get
+         back, so check again after refilling. */
+      intr_set_level (old_level);
+      if (!refill ())
+        return NULL;
+      old_level = intr_disable ();
+    }
+  b = free_bufs;
+  free_bufs = b->next;
+  alloc_cnt++;
+  if (++in_use_cnt > peak_cnt)
+    peak_cnt = in_use_cnt;
+  intr_set_level (old_level);
+  return b;
+}
+
+/* Returns buffer BUF, obtained from sector_buf_alloc(), to the
+   pool.  Does nothing if BUF is a null pointer. */
+void
+sector_buf_free (void *buf)
+{
+  struct free_buf *b = buf;
+  enum intr_level old_level;
+
+  if (b == NULL)
+    return;
+  ASSERT ((uintptr_t) b % BLOCK_SECTOR_SIZE == 0);
+
+  old_level = intr_disable ();
+  b->next = free_bufs;
+  free_bufs = b;
+  in_use_cnt--;
+  intr_set_level (old_level);
+}
+
+/* Prints sector buffer pool statistics. */
+void
+sector_pool_print_stats (void)
+{
+  printf ("Sector buffers: %lld malloc/free pairs replaced, "
+          "peak %d in use, %lld pages\n",
+          alloc_cnt, peak_cnt, page_cnt);
+}
@@ -0,0 +1,9 @@
+#ifndef FILESYS_SECTOR_POOL_H
+#define FILESYS_SECTOR_POOL_H
+
+void sector_pool_init (void);
+void *sector_buf_alloc (void);
+void sector_buf_free (void *);
+void sector_pool_print_stats (void);
+
+#endif /* filesys/sector-pool.h */
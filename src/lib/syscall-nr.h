@@ -28,7 +28,18 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_COPY_RANGE,             /* Copy data between two files. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read from a file into several buffers. */
+    SYS_WRITEV,                 /* Write to a file from several buffers. */
+    SYS_FILEBLOCKS,             /* Obtain a file's allocated sectors. */
+    SYS_FSYNC,                  /* Make a file's writes durable. */
+    SYS_WAIT_ANY,               /* Wait for any child process to die. */
+    SYS_YIELD                   /* Give up the CPU to another process. */
   };
 
 #endif /* lib/syscall-nr.h */
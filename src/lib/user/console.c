@@ -3,6 +3,35 @@
 #include <syscall.h>
 #include <syscall-nr.h>
 
+/* Output to STDOUT_FILENO is collected here and written out a
+   line at a time, when the buffer fills, or before anything else
+   that could make it appear out of order: another write to the
+   console, a read from it, exec(), exit(), or halt(). */
+static char stdout_buf[1024];
+static size_t stdout_cnt;
+
+/* Adds C to the standard output buffer, flushing it at the end
+   of a line or if it fills up. */
+static void
+stdout_putc (char c) 
+{
+  stdout_buf[stdout_cnt++] = c;
+  if (c == '\n' || stdout_cnt >= sizeof stdout_buf)
+    __flush_stdout ();
+}
+
+/* Writes out anything in the standard output buffer. */
+void
+__flush_stdout (void) 
+{
+  size_t cnt = stdout_cnt;
+
+  /* Empty the buffer first, because write() flushes it too. */
+  stdout_cnt = 0;
+  if (cnt > 0)
+    write (STDOUT_FILENO, stdout_buf, cnt);
+}
+
 /* The standard vprintf() function,
    which is like printf() but uses a va_list. */
 int
@@ -30,8 +59,9 @@ hprintf (int handle, const char *format, ...)
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
-  putchar ('\n');
+  while (*s != '\0')
+    stdout_putc (*s++);
+  stdout_putc ('\n');
 
   return 0;
 }
@@ -40,8 +70,7 @@ puts (const char *s)
 int
 putchar (int c) 
 {
-  char c2 = c;
-  write (STDOUT_FILENO, &c2, 1);
+  stdout_putc (c);
   return c;
 }
 
@@ -55,6 +84,7 @@ struct vhprintf_aux
   };
 
 static void add_char (char, void *);
+static void add_stdout_char (char, void *);
 static void flush (struct vhprintf_aux *);
 
 /* Formats the printf() format specification FORMAT with
@@ -64,6 +94,14 @@ int
 vhprintf (int handle, const char *format, va_list args) 
 {
   struct vhprintf_aux aux;
+
+  if (handle == STDOUT_FILENO)
+    {
+      int char_cnt = 0;
+      __vprintf (format, args, add_stdout_char, &char_cnt);
+      return char_cnt;
+    }
+
   aux.p = aux.buf;
   aux.char_cnt = 0;
   aux.handle = handle;
@@ -84,6 +122,16 @@ add_char (char c, void *aux_)
   aux->char_cnt++;
 }
 
+/* Adds C to the standard output buffer and counts it in the int
+   that CHAR_CNT points to. */
+static void
+add_stdout_char (char c, void *char_cnt_) 
+{
+  int *char_cnt = char_cnt_;
+  stdout_putc (c);
+  (*char_cnt)++;
+}
+
 /* Flushes the buffer in AUX. */
 static void
 flush (struct vhprintf_aux *aux)
@@ -4,4 +4,7 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Internal functions. */
+void __flush_stdout (void);
+
 #endif /* lib/user/stdio.h */
@@ -1,4 +1,5 @@
 #include <syscall.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
 /* Invokes syscall NUMBER, passing no arguments, and returns the
@@ -61,9 +62,29 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 void
 halt (void) 
 {
+  __flush_stdout ();
   syscall0 (SYS_HALT);
   NOT_REACHED ();
 }
@@ -71,6 +92,7 @@ halt (void)
 void
 exit (int status)
 {
+  __flush_stdout ();
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -78,6 +100,7 @@ exit (int status)
 pid_t
 exec (const char *file)
 {
+  __flush_stdout ();
   return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
@@ -114,12 +137,16 @@ filesize (int fd)
 int
 read (int fd, void *buffer, unsigned size)
 {
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO)
+    __flush_stdout ();
   return syscall3 (SYS_READ, fd, buffer, size);
 }
 
 int
 write (int fd, const void *buffer, unsigned size)
 {
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO)
+    __flush_stdout ();
   return syscall3 (SYS_WRITE, fd, buffer, size);
 }
 
@@ -182,3 +209,61 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+int
+copy_range (int in_fd, int out_fd, unsigned length)
+{
+  return syscall3 (SYS_COPY_RANGE, in_fd, out_fd, length);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO)
+    __flush_stdout ();
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO)
+    __flush_stdout ();
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+fileblocks (int fd)
+{
+  return syscall1 (SYS_FILEBLOCKS, fd);
+}
+
+int
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
+
+pid_t
+wait_any (int *status)
+{
+  return syscall1 (SYS_WAIT_ANY, status);
+}
+
+void
+yield (void)
+{
+  syscall0 (SYS_YIELD);
+}
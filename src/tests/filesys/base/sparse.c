@@ -0,0 +1,50 @@
+/* Creates a large file and checks that it starts out occupying
+   no data sectors and reading as zeros, then writes a single
+   byte in the middle of it and checks that only the sectors
+   needed to hold that byte were allocated. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_SIZE (1024 * 1024)
+#define BYTE_OFS (FILE_SIZE / 2 + 100)
+
+static char buf[512];
+
+void
+test_main (void) 
+{
+  int fd;
+  size_t i;
+
+  CHECK (create ("sparse", FILE_SIZE), "create \"sparse\"");
+  CHECK ((fd = open ("sparse")) > 1, "open \"sparse\"");
+  CHECK (fileblocks (fd) == 0, "no sectors allocated");
+
+  msg ("read hole");
+  seek (fd, FILE_SIZE / 2);
+  if (read (fd, buf, sizeof buf) != sizeof buf)
+    fail ("read \"sparse\" failed");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != 0)
+      fail ("byte %zu of hole is %d, not 0", i, buf[i]);
+
+  seek (fd, BYTE_OFS);
+  CHECK (write (fd, "x", 1) == 1, "write one byte");
+
+  /* One data sector, plus the index blocks that map it. */
+  CHECK (fileblocks (fd) >= 1 && fileblocks (fd) <= 3,
+         "few sectors allocated");
+
+  msg ("read back");
+  seek (fd, FILE_SIZE / 2);
+  if (read (fd, buf, sizeof buf) != sizeof buf)
+    fail ("read \"sparse\" failed");
+  for (i = 0; i < sizeof buf; i++)
+    if (buf[i] != (i == BYTE_OFS - FILE_SIZE / 2 ? 'x' : 0))
+      fail ("byte %zu is %d", i, buf[i]);
+
+  msg ("close \"sparse\"");
+  close (fd);
+}
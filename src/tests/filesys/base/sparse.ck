@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse) begin
+(sparse) create "sparse"
+(sparse) open "sparse"
+(sparse) no sectors allocated
+(sparse) read hole
+(sparse) write one byte
+(sparse) few sectors allocated
+(sparse) read back
+(sparse) close "sparse"
+(sparse) end
+EOF
+pass;
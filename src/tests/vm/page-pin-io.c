@@ -0,0 +1,51 @@
+/* Fills 2 MB of memory, so that most of it is paged out, then
+   writes part of it to a file and reads it back into another
+   paged-out region with single read and write system calls,
+   verifying that the kernel's direct transfers between the disk
+   and user pages see the right data. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/arc4.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 1024 * 1024)
+#define FILE_SIZE (256 * 1024)
+
+/* Unaligned destination, so that the first and last sectors of
+   the read are partial. */
+#define DST_OFS (SIZE / 2 + 123)
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  struct arc4 arc4;
+  int handle;
+  size_t i;
+
+  msg ("initialize");
+  memset (buf, 0, sizeof buf);
+  arc4_init (&arc4, "foobar", 6);
+  arc4_crypt (&arc4, buf, SIZE);
+
+  CHECK (create ("pinned", FILE_SIZE), "create \"pinned\"");
+  CHECK ((handle = open ("pinned")) > 1, "open \"pinned\"");
+  if (write (handle, buf, FILE_SIZE) != FILE_SIZE)
+    fail ("write \"pinned\" failed");
+  msg ("write \"pinned\"");
+
+  seek (handle, 0);
+  if (read (handle, buf + DST_OFS, FILE_SIZE) != FILE_SIZE)
+    fail ("read \"pinned\" failed");
+  msg ("read \"pinned\"");
+
+  msg ("compare");
+  for (i = 0; i < FILE_SIZE; i++)
+    if (buf[DST_OFS + i] != buf[i])
+      fail ("byte %zu differs", i);
+
+  close (handle);
+}
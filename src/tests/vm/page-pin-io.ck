@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-pin-io) begin
+(page-pin-io) initialize
+(page-pin-io) create "pinned"
+(page-pin-io) open "pinned"
+(page-pin-io) write "pinned"
+(page-pin-io) read "pinned"
+(page-pin-io) compare
+(page-pin-io) end
+EOF
+pass;
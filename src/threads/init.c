@@ -116,6 +116,7 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  process_init ();
 
    //init frame table
   init_frame_table();
@@ -266,6 +267,8 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+      else if (!strcmp (name, "-sc"))
+        syscall_stats_per_process = true;
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -388,6 +391,7 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+          "  -sc                Print system call statistics at process exit.\n"
 #endif
           );
   shutdown_power_off ();
@@ -23,9 +23,16 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, in one FIFO queue per
+   priority.  Bit P of ready_mask is set if and only if
+   ready_queues[P] is nonempty, so the highest priority with a
+   ready thread is found in constant time.  ready_cnt counts them
+   all.  Accessed with interrupts off. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+static struct list ready_queues[PRI_CNT];
+static uint64_t ready_mask;
+static size_t ready_cnt;
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -60,6 +67,12 @@ static long long user_ticks;    /* # of timer ticks in user programs. */
 #define TIME_SLICE 4            /* # of timer ticks to give each thread. */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
 
+/* Pages of threads that have exited, kept for new threads instead
+   of going back to palloc.  Accessed with interrupts off. */
+#define FREE_THREAD_CNT 8
+static struct thread *free_threads[FREE_THREAD_CNT];
+static size_t free_thread_cnt;
+
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
@@ -79,7 +92,11 @@ static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
 
-void sort_ready_list_priority(void);
+static int sched_priority (const struct thread *);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static int ready_max_priority (void);
+static void ready_requeue (struct thread *);
 bool check_current_thread_priority_against_ready(void);
 
 /* Alarm clock functions*/
@@ -113,10 +130,13 @@ void calculate_thread_priority (struct thread *t, void *aux);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < PRI_CNT; i++)
+    list_init (&ready_queues[i]);
   list_init (&all_list);
   list_init(&sleeping_thread_list);
 
@@ -196,23 +216,68 @@ thread_print_stats (void)
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
+{
+  struct thread *t = thread_spawn (name, priority, function, aux);
+  tid_t tid;
+
+  if (t == NULL)
+    return TID_ERROR;
+  tid = t->tid;
+  thread_launch (t);
+  return tid;
+}
+
+/* Returns a page for a new thread, reusing one left by a thread
+   that exited if there is one. */
+static struct thread *
+alloc_thread_page (void)
+{
+  struct thread *t = NULL;
+  enum intr_level old_level = intr_disable ();
+
+  if (free_thread_cnt > 0)
+    t = free_threads[--free_thread_cnt];
+  intr_set_level (old_level);
+
+  return t != NULL ? t : palloc_get_page (PAL_ZERO);
+}
+
+/* Gives back T's page, keeping it for a new thread if there is
+   room.  Interrupts must be off. */
+static void
+free_thread_page (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (free_thread_cnt < FREE_THREAD_CNT)
+    free_threads[free_thread_cnt++] = t;
+  else
+    palloc_free_page (t);
+}
+
+/* Like thread_create(), but returns the new thread without
+   adding it to the ready queue, or a null pointer if creation
+   fails.  The caller may finish setting the thread up, then must
+   call thread_launch() to start it.  Until then the thread cannot
+   run, let alone exit, so the pointer stays valid. */
+struct thread *
+thread_spawn (const char *name, int priority,
+              thread_func *function, void *aux) 
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
-  tid_t tid;
 
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
-    return TID_ERROR;
+    return NULL;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
-  tid = t->tid = allocate_tid ();
+  t->tid = allocate_tid ();
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -229,6 +294,45 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
   sf->ebp = 0;
 
+  return t;
+}
+
+/* Frees T, returned by thread_spawn(), instead of launching it. */
+void
+thread_discard (struct thread *t) 
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+  ASSERT (t->status == THREAD_BLOCKED);
+
+  old_level = intr_disable ();
+  list_remove (&t->allelem);
+  free_thread_page (t);
+  intr_set_level (old_level);
+}
+
+/* Gives back the page of T, a thread that has died but whose page
+   was kept for process_reap_later(). */
+void
+thread_free (struct thread *t) 
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+  ASSERT (t->status == THREAD_DYING);
+
+  old_level = intr_disable ();
+  free_thread_page (t);
+  intr_set_level (old_level);
+}
+
+/* Adds T, returned by thread_spawn(), to the ready queue, and
+   yields to it if it should run before the current thread.  T may
+   run, and even exit, before thread_launch() returns. */
+void
+thread_launch (struct thread *t) 
+{
   /* Add to run queue. */
   thread_unblock (t);
 
@@ -239,8 +343,6 @@ thread_create (const char *name, int priority,
       thread_yield();
     }
   }
-
-  return tid;
 }
 
 /* Puts the current thread to sleep.  It will not be scheduled
@@ -276,8 +378,7 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  //priority scheduling so insert into ready list based off priority
-  list_insert_ordered(&ready_list, &t->elem, compare_thread_priority, NULL);
+  ready_push (t);
   t->status = THREAD_READY;
   intr_set_level (old_level);
 }
@@ -347,9 +448,7 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (thread_current() != idle_thread) 
-    //priority scheduling so insert into ready list based off priority
-    list_insert_ordered(&ready_list, &thread_current()->elem, 
-                        compare_thread_priority, NULL);
+    ready_push (thread_current ());
   thread_current()->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -546,12 +645,13 @@ init_thread (struct thread *t, const char *name, int priority)
   } 
 
   #ifdef USERPROG
-  sema_init(&t->wait_sema, 0);
-  sema_init(&t->exec_sema, 0);
   list_init(&t->child_processes);
-  t->curr_fd = 3;
+  list_init(&t->exited_children);
+  cond_init(&t->child_exited);
+  t->fd_table = NULL;
+  t->fd_map = NULL;
   t->exit_code = -1;
-  list_init(&t->opened_files);
+  t->cwd = NULL;
   sup_pt_init(&t->spt);
   list_init(&t->mmap_files);
   #endif
@@ -583,11 +683,83 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  int priority = ready_max_priority ();
+  struct thread *t;
+
+  if (priority < PRI_MIN)
     return idle_thread;
-  else
-    //ready list sorted in order of ascending priority so pop back
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  t = list_entry (list_front (&ready_queues[priority]), struct thread, elem);
+  ready_remove (t);
+  return t;
+}
+
+/* Returns the priority that T is scheduled by. */
+static int
+sched_priority (const struct thread *t) 
+{
+  return thread_mlfqs ? t->priority : t->effective_priority;
+}
+
+/* Adds T to the back of the ready queue for its priority.
+   Interrupts must be off. */
+static void
+ready_push (struct thread *t) 
+{
+  int priority = sched_priority (t);
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (priority >= PRI_MIN && priority <= PRI_MAX);
+
+  t->ready_priority = priority;
+  list_push_back (&ready_queues[priority], &t->elem);
+  ready_mask |= (uint64_t) 1 << priority;
+  ready_cnt++;
+}
+
+/* Takes T out of the ready queue it is in.  Interrupts must be
+   off. */
+static void
+ready_remove (struct thread *t) 
+{
+  struct list *queue = &ready_queues[t->ready_priority];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  list_remove (&t->elem);
+  if (list_empty (queue))
+    ready_mask &= ~((uint64_t) 1 << t->ready_priority);
+  ready_cnt--;
+}
+
+/* Returns the highest priority of any ready thread, or
+   PRI_MIN - 1 if there are none.  The mask is scanned a half at
+   a time because a 64-bit count of leading zeros would need
+   libgcc. */
+static int
+ready_max_priority (void) 
+{
+  uint32_t hi = ready_mask >> 32;
+  uint32_t lo = ready_mask;
+
+  if (hi != 0)
+    return 63 - __builtin_clz (hi);
+  if (lo != 0)
+    return 31 - __builtin_clz (lo);
+  return PRI_MIN - 1;
+}
+
+/* Moves T, if it is ready, to the back of the ready queue for its
+   priority after that changed.  Interrupts must be off. */
+static void
+ready_requeue (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->status == THREAD_READY && t->ready_priority != sched_priority (t)) 
+    {
+      ready_remove (t);
+      ready_push (t);
+    }
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -632,7 +804,13 @@ thread_schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+#ifdef USERPROG
+      /* A process's address space and files are torn down later,
+         and they are reached through its page. */
+      if (process_reap_later (prev))
+        return;
+#endif
+      free_thread_page (prev);
     }
 }
 
@@ -709,19 +887,11 @@ compare_thread_priority(const struct list_elem *a, const struct list_elem *b,
   }
 }
 
-/* Sort the ready list */
-void
-sort_ready_list_priority(void) {
-  if (!list_empty(&ready_list))
-    list_sort(&ready_list, compare_thread_priority, NULL);
-}
-
 /* Check if current thread's priority is less than the highest 
-   priority thread in ready list */
+   priority of a ready thread */
 bool
 check_current_thread_priority_against_ready(void) {
-  return compare_thread_priority(list_begin(&ready_list), 
-                                 &thread_current()->elem, NULL);
+  return ready_max_priority() > sched_priority(thread_current());
 }
 
 /* Alarm Clock Functions */
@@ -786,9 +956,11 @@ handle_lock_block(struct lock *lock) {
         < thread_current()->effective_priority) {
       blocking_thread->effective_priority = 
         thread_current()->effective_priority;
-      /* Check if the blocking thread is in the ready list */
+      /* Check if the blocking thread is in a ready queue */
       if (blocking_thread->status == THREAD_READY) {
-        sort_ready_list_priority();
+        enum intr_level old_level = intr_disable();
+        ready_requeue(blocking_thread);
+        intr_set_level(old_level);
         break;
       }
     }
@@ -855,8 +1027,8 @@ void
 calculate_thread_load_avg(void) {
   // Idle thread shouldn't count as a ready/running thread
   int num_running_threads = thread_current() == idle_thread
-                                ? list_size(&ready_list)
-                                : list_size(&ready_list) + 1;
+                                ? ready_cnt
+                                : ready_cnt + 1;
   // Kept all values as fixed point to avoid rounding errors
   load_avg = multiply_fp(divide_fp(int_to_fp(1), int_to_fp(60)),
                          int_to_fp(num_running_threads)) +
@@ -916,6 +1088,9 @@ calculate_thread_priority(struct thread *t, void *aux) {
   else if (priority < PRI_MIN) priority = PRI_MIN;
   
   t->priority = priority;
+  /* A ready thread moves to the queue for its new priority */
+  if (t->status == THREAD_READY)
+    ready_requeue(t);
 
   (void)aux;
   return;
@@ -942,55 +1117,3 @@ handle_mlfqs(int64_t ticks) {
     }
   }
 }
-
-/**
-create and init new child
-retuen the created child
-*/
-struct child_process*
-create_child(struct thread *t)
-{
-  struct child_process* child = malloc(sizeof(struct child_process));
-  child -> pid = t->tid;
-  child -> is_alive = true;
-  child -> first_wait = true;
-  child -> load_success = false;
-  child -> t = t;
-  child -> exit_code = 0;
-  return child;
-}
-
-/**
-iterate on child_processes and return the child which have the tid
-*/
-struct child_process*
-find_child_from_id(tid_t tid, struct list *child_processes)
-{
-  struct list_elem* e;
-  if(list_size(child_processes) <= 0)
-    return NULL;
-  for (e = list_begin (child_processes); e != list_end (child_processes); e = list_next (e))
-  {
-    struct child_process *child = list_entry (e, struct child_process, child_elem);
-    if(child -> pid == tid)
-    {
-        return child;
-    }
-  }
-  return NULL;
-}
-
-/*Function used to get thread with tid id from the list of all threads
-if no such thread exists, return NULL*/
-struct thread* find_thread_from_id (tid_t id){
-  struct thread* curr_thread;
-  struct list_elem* e;
-  for (e = list_begin (&all_list); e != list_end (&all_list);
-       e = list_next (e)){
-      //if find thread return
-      curr_thread = list_entry (e, struct thread, allelem);
-      if(curr_thread->tid == id)
-        return curr_thread;
-    }
-  return NULL;
-}
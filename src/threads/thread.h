@@ -2,6 +2,7 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
 #include <stdint.h>
 #include "threads/synch.h"
@@ -92,6 +93,7 @@ struct thread
     uint8_t *stack;                     /* Saved stack pointer. */
     int priority;                       /* Priority. */
     int effective_priority;             /* Priority accounting for donations */
+    int ready_priority;                 /* Ready queue the thread is in */
     struct lock *blocking_lock;         /* Lock that is blocking thread */
     struct list owned_locks;            /* List of locks the thread owns */
     int nice;                           /* Nice value for mlfqs */ 
@@ -101,13 +103,15 @@ struct thread
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
 
-    int curr_fd;                     /* current file descriptor*/
-    struct list opened_files;             /* list of files opened by the thread*/
+    struct process_file** fd_table;  /* open files indexed by fd - FD_BASE*/
+    struct bitmap* fd_map;           /* slots of fd_table in use*/
+    struct dir *cwd;                 /* working directory, NULL for root*/
+    int journal_depth;               /* Owned by filesys/journal.c: nested operations*/
 
-    struct semaphore wait_sema;     /*semaphore used to wait on children*/
-    struct semaphore exec_sema;
-    struct list child_processes;          /*list of child processes*/
-    struct thread* parent;
+    struct list child_processes;          /*records of running children*/
+    struct list exited_children;          /*records of children not yet waited for*/
+    struct condition child_exited;        /*signaled when a child exits*/
+    struct child_process* record;         /*own record, NULL if no parent*/
     int exit_code;
 
     struct list spt;         /* Supplemental page table */
@@ -117,6 +121,9 @@ struct thread
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
     void *curr_esp;                         /* Stack pointer */
+    bool in_user_copy;                  /* In a fault-safe user copy? */
+    bool syscall_error;                 /* Kill after this syscall? */
+    struct syscall_stat *syscall_stats; /* Per-syscall counts, or NULL. */
 
 #endif
 
@@ -124,14 +131,18 @@ struct thread
     unsigned magic;                     /* Detects stack overflow. */
   };
 
+  /* Shared by a parent and a child process, and freed once both
+     have let go of it. Owned by userprog/process.c. */
   struct child_process {
    tid_t pid;                               /* process id for the child */
-   bool is_alive;                           /* boolean indicating if the child is still alive*/
+   struct thread *parent;                   /* parent, NULL once it has exited */
+   int ref_cnt;                             /* parent and/or child still holding it */
+   bool exited;                             /* true once the child has exited */
    bool load_success;                       /* boolean indicating if child has successfully loaded */
-   bool first_wait;                         /* boolean indicating if this is the first time wait has been called on the child */
    int exit_code;                           /* exit code for a process*/
-   struct thread *t;                        /* thread corresponding to child process*/
-   struct list_elem child_elem;           /*elem used in list of child processes*/
+   struct semaphore load_sema;              /* upped once the child has tried to load */
+   struct hash_elem hash_elem;              /* elem in the table of records by pid */
+   struct list_elem child_elem;           /*elem in the parent's child_processes or exited_children*/
   };
 
   typedef int mapid_t;
@@ -156,6 +167,11 @@ void thread_print_stats (void);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+struct thread *thread_spawn (const char *name, int priority,
+                             thread_func *, void *);
+void thread_launch (struct thread *);
+void thread_discard (struct thread *);
+void thread_free (struct thread *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
@@ -189,13 +205,4 @@ int thread_get_recent_cpu (void);
 int thread_get_load_avg (void);
 void handle_mlfqs(int64_t ticks);
 
-/*Function used to get child thread with tid id from t's list of child threads
-if no such thread exists, return NULL*/
-struct child_process* find_child_from_id(tid_t tid, struct list *mylist);
-
-struct child_process* create_child(struct thread *t);
-
-/*Function used to get thread with tid id from the list of all threads
-if no such thread exists, return NULL*/
-struct thread* find_thread_from_id (tid_t id);
 #endif /* threads/thread.h */
\ No newline at end of file
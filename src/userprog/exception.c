@@ -113,6 +113,22 @@ kill (struct intr_frame *f)
     }
 }
 
+/* Gives up on a page fault that cannot be resolved.  A fault
+   inside the kernel's fault-safe user memory copy resumes at the
+   address the copy left in eax, with eax set to -1, so that the
+   copy reports failure; any other fault kills the process. */
+static void
+fault_failed (struct intr_frame *f, bool user)
+{
+  if (!user && thread_current ()->in_user_copy)
+    {
+      f->eip = (void *) f->eax;
+      f->eax = 0xffffffff;
+    }
+  else
+    proc_exit (-1);
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -172,40 +188,34 @@ page_fault (struct intr_frame *f)
 
       if((esp - ABOVE_STACK_LIMIT) <= fault_addr  && MAX_STACK_SIZE >=(PHYS_BASE - pg_round_down(fault_addr))){
          if(!increase_stack_size(fault_addr, thread_current()))
-            proc_exit(-1);
+            fault_failed(f, user);
       }
       else{
          if (!pagedir_get_page (thread_current()->pagedir, fault_addr)) {
-            proc_exit(-1);
+            fault_failed(f, user);
          }
       }
       return;
    } else{
+      bool loaded;
       lock_acquire(&spf->eviction_lock);
       // User is trying to write to a page that is not writable
       if (!spf->writable && write) 
-         proc_exit(-1);
-
-      if(spf->type == FILE_ORIGIN) {
+         loaded = false;
+      else if(spf->type == FILE_ORIGIN) {
          // Load the page from the file
-         if(!sup_load_file(spf))
-            proc_exit(-1);
+         loaded = sup_load_file(spf);
       }
       else if(spf->type == SWAP_ORIGIN) {
          // Load the page from the swap
-         if(!sup_load_swap(spf))
-            proc_exit(-1);
+         loaded = sup_load_swap(spf);
       } else{
-            if (!pagedir_get_page (thread_current()->pagedir, fault_addr)) 
-               proc_exit(-1);
+         loaded = pagedir_get_page (thread_current()->pagedir, fault_addr) != NULL;
       }
+      //release before giving up, the process may only be failing a copy
       lock_release(&spf->eviction_lock);
-      return;
-   }
-   // Kernel Mode, change eip and eax value 
-   if(!user) {
-      f->eip = (void *) f->eax;
-      f->eax = 0xffffffff;
+      if(!loaded)
+         fault_failed(f, user);
       return;
    }
 
@@ -3,6 +3,7 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "vm/frame.h"
@@ -10,6 +11,14 @@
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
 
+/* Page directories of processes that have exited, with their user
+   entries cleared, kept for new processes.  Their kernel entries
+   still match init_page_dir, which does not change after boot.
+   Accessed with interrupts off. */
+#define FREE_PD_CNT 8
+static uint32_t *free_pds[FREE_PD_CNT];
+static size_t free_pd_cnt;
+
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
@@ -17,7 +26,16 @@ static void invalidate_pagedir (uint32_t *);
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
+  uint32_t *pd = NULL;
+  enum intr_level old_level = intr_disable ();
+
+  if (free_pd_cnt > 0)
+    pd = free_pds[--free_pd_cnt];
+  intr_set_level (old_level);
+  if (pd != NULL)
+    return pd;
+
+  pd = palloc_get_page (0);
   if (pd != NULL)
     memcpy (pd, init_page_dir, PGSIZE);
   return pd;
@@ -28,6 +46,7 @@ pagedir_create (void)
 void
 pagedir_destroy (uint32_t *pd) 
 {
+  enum intr_level old_level;
   uint32_t *pde;
 
   if (pd == NULL)
@@ -38,14 +57,22 @@ pagedir_destroy (uint32_t *pd)
     if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
-        uint32_t *pte;
-        
-        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
-            frame_free (pte_get_page (*pte));
+
+        frame_free_mapped (pt, PGSIZE / sizeof *pt);
         frame_free (pt);
       }
-  frame_free (pd);
+
+  /* Keep PD for another process if there is room. */
+  memset (pd, 0, pd_no (PHYS_BASE) * sizeof *pd);
+  old_level = intr_disable ();
+  if (free_pd_cnt < FREE_PD_CNT)
+    {
+      free_pds[free_pd_cnt++] = pd;
+      pd = NULL;
+    }
+  intr_set_level (old_level);
+  if (pd != NULL)
+    frame_free (pd);
 }
 
 /* Returns the address of the page table entry for virtual
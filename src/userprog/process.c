@@ -11,6 +11,7 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
@@ -21,58 +22,294 @@
 #include <stdbool.h>
 #include "filesys/file.h"
 #include "threads/malloc.h"
+#include <bitmap.h>
 #include "vm/frame.h"
 #include "vm/page.h"
 
 #define MAX_ARGS 32 //maximum amount of args for a command; arbitrary
+#define FD_INIT_CNT 16 //initial size of a process' fd table
+#define EXEC_REAP_CNT 2 //most exited processes an exec tears down itself
+
+/*Passed from process_execute to start_process, allocated together with
+the arguments it points into*/
+struct start_info{
+    struct child_process* record;/*parent's record of the child*/
+    struct dir* cwd;            /*child's working directory, NULL for root*/
+    int argc;                   /*number of arguments, the first is the program*/
+    size_t args_len;            /*bytes in args*/
+    uint16_t argv_ofs[MAX_ARGS];/*offset of each argument in args*/
+    char args[];                /*the arguments, each null terminated*/
+};
 
 static thread_func start_process NO_RETURN;
-static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static bool load (const struct start_info *info, void (**eip) (void),
+                  void **esp);
+
+/*Records of the children that a parent may still wait for, by pid, and
+the lock that protects them, every process's child lists and the
+fields of every record*/
+static struct hash child_records;
+static struct lock child_lock;
+
+/*Returns a hash value for child record e*/
+static unsigned
+child_hash(const struct hash_elem* e, void* aux UNUSED){
+  return hash_int(hash_entry(e, struct child_process, hash_elem)->pid);
+}
+
+/*Returns true if child record a's pid precedes b's*/
+static bool
+child_less(const struct hash_elem* a, const struct hash_elem* b,
+           void* aux UNUSED){
+  return hash_entry(a, struct child_process, hash_elem)->pid
+         < hash_entry(b, struct child_process, hash_elem)->pid;
+}
+
+/*Returns the record of the child with the given pid, or NULL if there
+is none. Must be called with child_lock held*/
+static struct child_process*
+find_child(tid_t pid){
+  struct child_process key;
+  struct hash_elem* e;
+  key.pid = pid;
+  e = hash_find(&child_records, &key.hash_elem);
+  return e != NULL ? hash_entry(e, struct child_process, hash_elem) : NULL;
+}
+
+/*Creates the record shared by the current thread and its new child t,
+which must not have run yet. Returns NULL if memory runs out*/
+static struct child_process*
+create_child(struct thread* t){
+  struct thread* cur = thread_current();
+  struct child_process* child = malloc(sizeof(struct child_process));
+  if(child == NULL)
+    return NULL;
+  child->pid = t->tid;
+  child->parent = cur;
+  child->ref_cnt = 2;
+  child->exited = false;
+  child->load_success = false;
+  child->exit_code = -1;
+  sema_init(&child->load_sema, 0);
+  t->record = child;
+
+  lock_acquire(&child_lock);
+  hash_insert(&child_records, &child->hash_elem);
+  list_push_back(&cur->child_processes, &child->child_elem);
+  lock_release(&child_lock);
+  return child;
+}
+
+/*Drops one holder's reference to child, freeing it after the last.
+Must be called with child_lock held*/
+static void
+release_child(struct child_process* child){
+  ASSERT(child->ref_cnt > 0);
+  if(--child->ref_cnt == 0)
+    free(child);
+}
+
+/*Takes child, which has exited, off its parent's lists and returns its
+exit code, after which its pid is no longer the parent's to wait for.
+Must be called with child_lock held*/
+static int
+reap_child(struct child_process* child){
+  int exit_code = child->exit_code;
+  ASSERT(child->exited);
+  list_remove(&child->child_elem);
+  hash_delete(&child_records, &child->hash_elem);
+  release_child(child);
+  return exit_code;
+}
+
+/*Publishes the current process's exit code to its parent, waking it if
+it is waiting, and lets go of the records of its own children, which
+nobody can wait for any more*/
+static void
+exit_children(void){
+  struct thread* cur = thread_current();
+  struct child_process* self = cur->record;
+  struct list* lists[] = {&cur->child_processes, &cur->exited_children};
+
+  lock_acquire(&child_lock);
+  if(self != NULL){
+    self->exit_code = cur->exit_code;
+    self->exited = true;
+    if(self->parent != NULL){
+      list_remove(&self->child_elem);
+      list_push_back(&self->parent->exited_children, &self->child_elem);
+      cond_broadcast(&self->parent->child_exited, &child_lock);
+    }
+    release_child(self);
+    cur->record = NULL;
+  }
+  for(size_t i = 0; i < sizeof lists / sizeof *lists; i++)
+    while(!list_empty(lists[i])){
+      struct child_process* child = list_entry(list_pop_front(lists[i]),
+                                               struct child_process, child_elem);
+      child->parent = NULL;
+      hash_delete(&child_records, &child->hash_elem);
+      release_child(child);
+    }
+  lock_release(&child_lock);
+}
+
+/*Processes that have exited but still have an address space or files
+to tear down, oldest first, and a count of them for the reaper. The
+scheduler adds to the list, so it is only touched with interrupts off*/
+static struct list dead_list;
+static struct semaphore dead_sema;
+
+/*Closes every file that exited process t left open, its working
+directory, then frees its frames, page tables and supplementary page
+table, and finally its page*/
+static void
+reap(struct thread* t){
+  if(t->fd_map != NULL){
+    size_t idx = 0;
+    while((idx = bitmap_scan(t->fd_map, idx, 1, true)) != BITMAP_ERROR){
+      struct process_file* f = t->fd_table[idx];
+      dir_close(f->dir);
+      file_close(f->file);
+      free(f);
+      idx++;
+    }
+    bitmap_destroy(t->fd_map);
+    free(t->fd_table);
+  }
+  dir_close(t->cwd);
+
+  //eviction can still pick t's frames until pagedir_destroy has freed
+  //them, and then needs its page directory and supplementary page table
+  if(t->pagedir != NULL)
+    pagedir_destroy(t->pagedir);
+  sup_page_cleanup(&t->spt);
+  thread_free(t);
+}
+
+/*Reaps the oldest process in dead_list, returning false if there is none*/
+static bool
+reap_one(void){
+  struct thread* t = NULL;
+  enum intr_level old_level = intr_disable();
+  if(!list_empty(&dead_list))
+    t = list_entry(list_pop_front(&dead_list), struct thread, elem);
+  intr_set_level(old_level);
+
+  if(t == NULL)
+    return false;
+  reap(t);
+  return true;
+}
+
+/*Reaper thread, which tears down exited processes whenever nothing
+else wants to run*/
+static void
+reaper(void* aux UNUSED){
+  for(;;){
+    sema_down(&dead_sema);
+    reap_one();
+  }
+}
+
+/*Splits CMD_LINE into arguments at spaces and returns them in a new
+start_info, or NULL if there are none, too many to fit on the new
+process's stack, or memory runs out*/
+static struct start_info*
+split_args(const char* cmd_line){
+  size_t len = strnlen(cmd_line, PGSIZE);
+  struct start_info* info = malloc(sizeof *info + len + 1);
+  char* dst;
+  size_t i = 0;
+  if(info == NULL)
+    return NULL;
+
+  //copy each argument with its null terminator, dropping the spaces
+  dst = info->args;
+  info->argc = 0;
+  for(;;){
+    while(i < len && cmd_line[i] == ' ')
+      i++;
+    if(i == len)
+      break;
+    if(info->argc == MAX_ARGS){
+      free(info);
+      return NULL;
+    }
+    info->argv_ofs[info->argc++] = dst - info->args;
+    while(i < len && cmd_line[i] != ' ')
+      *dst++ = cmd_line[i++];
+    *dst++ = '\0';
+  }
+  info->args_len = dst - info->args;
+
+  //the strings, the argv array with its sentinel, argv, argc and the
+  //return address all have to fit in the single stack page
+  if(info->argc == 0
+     || ROUND_UP(info->args_len, sizeof(char*))
+        + (info->argc + 4) * sizeof(char*) > PGSIZE){
+    free(info);
+    return NULL;
+  }
+  return info;
+}
 
 /* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
+   FILENAME and waits for it to load.  The new thread may exit
    before process_execute() returns.  Returns the new process's
-   thread id, or TID_ERROR if the thread cannot be created. */
+   thread id, or TID_ERROR if the thread cannot be created or the
+   program cannot be loaded. */
 tid_t
 process_execute (const char *file_name) 
 {
-  char *fn_copy;
-  char *fn_copy2;
-  char *user_program_name;
-  char *remaining_args;
+  struct thread* new;
+  struct child_process* child;
   tid_t tid;
 
-  /* Make a copy of FILE_NAME.
+  /* Split FILE_NAME into arguments once, in a copy.
      Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page (0);
-  if (fn_copy == NULL)
+  struct start_info* info = split_args(file_name);
+  if (info == NULL)
+    return TID_ERROR;
+
+  //finish off a couple of processes the reaper hasn't got to, so one
+  //that keeps spawning children can't outrun it and run the system out
+  //of memory. Reaping more than one lets a backlog shrink without
+  //making any single exec pay for all of it
+  for (int i = 0; i < EXEC_REAP_CNT && reap_one(); i++)
+    continue;
+
+  //the child starts in the parent's working directory, which has to
+  //be handed over before the child runs since load resolves against it
+  info->cwd = NULL;
+  if (thread_current()->cwd != NULL)
+    info->cwd = dir_reopen(thread_current()->cwd);
+
+  /* Create a new thread to execute FILE_NAME, named after the
+     program, which is the first argument.  It cannot run until
+     launched, so it can be linked to its parent first. */
+  new = thread_spawn (info->args, PRI_DEFAULT, start_process, info);
+  child = new != NULL ? create_child(new) : NULL;
+  if (child == NULL){
+    //a spawned thread that never ran only has its page to give back
+    if (new != NULL)
+      thread_discard(new);
+    dir_close(info->cwd);
+    free(info);
     return TID_ERROR;
-  strlcpy (fn_copy, file_name, PGSIZE);
-  // Another copy due to not being able to not copying properly from strtok_r
-  fn_copy2 = palloc_get_page (0);
-  if (fn_copy2 == NULL)
+  }
+  info->record = child;
+  tid = new->tid;
+  thread_launch(new);
+
+  //the child ups the semaphore in its record, which it doesn't own,
+  //so the handshake doesn't depend on the child's thread still existing
+  sema_down(&child->load_sema);
+  if (!child->load_success){
+    //the caller never learns this pid, so it must not show up in a
+    //later wait for any child
+    process_wait(tid);
     return TID_ERROR;
-  strlcpy (fn_copy2, file_name, PGSIZE);
-
-  // Only need program name for thread name
-  user_program_name = strtok_r((char*) fn_copy, " ", &remaining_args);
-
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create (user_program_name, PRI_DEFAULT, start_process, fn_copy2);
-  palloc_free_page (fn_copy);
-  if (tid == TID_ERROR)
-    palloc_free_page (fn_copy2);
-  else {
-    //disabling interrupts since dealing with global list of threads
-    enum intr_level old_level = intr_disable();
-    struct thread* cur = thread_current();
-    //finding thread from id then adding it to child processes
-    struct thread* new = find_thread_from_id(tid);
-    ASSERT(new != NULL);
-    struct child_process *child = create_child(new);
-    list_push_back(&cur->child_processes, &child->child_elem);
-    new->parent = cur;
-    intr_set_level(old_level);
   }
   return tid;
 }
@@ -80,29 +317,27 @@ process_execute (const char *file_name)
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process (void *file_name_)
+start_process (void *info_)
 {
-  char *file_name = file_name_;
+  struct start_info *info = info_;
   struct intr_frame if_;
   bool success;
   struct thread* cur = thread_current();
 
+  cur->cwd = info->cwd;
+
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
   if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
-  success = load (file_name, &if_.eip, &if_.esp);
-
-  if (cur->parent != NULL) {
-    struct child_process *child = find_child_from_id(cur->tid, &cur->parent->child_processes);
-    child->load_success = success;
-  }
+  success = load (info, &if_.eip, &if_.esp);
 
-  sema_up(&cur->exec_sema);
+  info->record->load_success = success;
+  sema_up(&info->record->load_sema);
 
   /* If load failed, quit. */
-  palloc_free_page (file_name);
+  free (info);
   if (!success) 
     thread_exit();
 
@@ -129,19 +364,42 @@ int
 process_wait (tid_t child_tid) 
 {
   struct thread* cur = thread_current();
-  struct child_process *child = find_child_from_id(child_tid, &cur->child_processes);
-
-  if(child == NULL)
-    return -1;
+  struct child_process *child;
+  int exit_code = -1;
+
+  lock_acquire(&child_lock);
+  child = find_child(child_tid);
+  if (child != NULL && child->parent == cur) {
+    while (!child->exited)
+      cond_wait(&cur->child_exited, &child_lock);
+    exit_code = reap_child(child);
+  }
+  lock_release(&child_lock);
+  return exit_code;
+}
 
-  if (child->first_wait) {
-    child->first_wait = false;
-    if (child->is_alive) {
-      sema_down(&(child->t->wait_sema)); 
-    }
-    return child->exit_code;
+/* Waits for any child of the current process to exit, stores its
+   exit status into *EXIT_CODE and returns its thread id.  Children
+   are reaped in the order they exited.  Returns TID_ERROR
+   immediately if the process has no children left to wait for. */
+tid_t
+process_wait_any (int *exit_code) 
+{
+  struct thread* cur = thread_current();
+  tid_t tid = TID_ERROR;
+
+  lock_acquire(&child_lock);
+  while (list_empty(&cur->exited_children)
+         && !list_empty(&cur->child_processes))
+    cond_wait(&cur->child_exited, &child_lock);
+  if (!list_empty(&cur->exited_children)) {
+    struct child_process* child = list_entry(list_front(&cur->exited_children),
+                                             struct child_process, child_elem);
+    tid = child->pid;
+    *exit_code = reap_child(child);
   }
-  return -1;
+  lock_release(&child_lock);
+  return tid;
 }
 
 /* Free the current process's resources. */
@@ -149,68 +407,42 @@ void
 process_exit (void)
 {
   struct thread *cur = thread_current ();
-  uint32_t *pd;
   printf("%s: exit(%d)\n", cur->name, cur->exit_code);
-  /*call close on all of the process' files*/
-
-  if (cur->parent != NULL) {
-    struct child_process *child = find_child_from_id(cur->tid, &cur->parent->child_processes);
-    if (child != NULL && child->is_alive) {
-      child->is_alive = false;
-    }
-  }
-
-  //since exited process, allow parent to continue
-  sema_up(&cur->wait_sema);
-
-  free_children(&cur->child_processes);
-
-  cur->parent = NULL;
-  
-  while(!list_empty(&cur->opened_files)){
-    struct list_elem* e = list_pop_front(&cur->opened_files);
-    struct process_file* f = list_entry(e, struct process_file, elem);
-    close_proc_file(f, true);
-  }
+  syscall_print_process_stats(cur);
+  free(cur->syscall_stats);
+  cur->syscall_stats = NULL;
 
+  /*write back mapped files first, since the parent may read them as
+  soon as its wait returns, and this needs the process's own pages*/
   while (!list_empty(&cur->mmap_files)) {
     struct mmap_file *mmap_f = list_entry(list_begin(&cur->mmap_files), struct mmap_file, mmap_elem);
     munmap_helper(mmap_f->id);
   }
-  
-  /* Destroy the current process's page directory and switch back
-     to the kernel-only page directory. */
-  pd = cur->pagedir;
-  if (pd != NULL) 
-    {
-      /* Correct ordering here is crucial.  We must set
-         cur->pagedir to NULL before switching page directories,
-         so that a timer interrupt can't switch back to the
-         process page directory.  We must activate the base page
-         directory before destroying the process's page
-         directory, or our active page directory will be one
-         that's been freed (and cleared). */
-      cur->pagedir = NULL;
-      pagedir_activate (NULL);
-      pagedir_destroy (pd);
-    }
+
+  //since exited process, allow parent to continue
+  exit_children();
+
+  /* The files, working directory and address space are left for
+     the reaper, which process_reap_later() hands them to once the
+     scheduler has switched away from this thread for good.  Until
+     then the page directory stays active. */
 }
 
-/**
-free all the children in the child_list
-*/
-void
-free_children(struct list *child_list)
+/* Queues T, a thread that has exited and been switched away from
+   for the last time, for the reaper if it still has files or an
+   address space to tear down.  Returns true if so, in which case
+   T's page is given back after the teardown.  Called by the
+   scheduler with interrupts off. */
+bool
+process_reap_later (struct thread *t)
 {
-    struct list_elem* e1 = list_begin(child_list);
-    while(e1!=list_end(child_list))
-    {
-        struct list_elem* next = list_next(e1);
-        struct child_process* c = list_entry(e1, struct child_process, child_elem);
-        list_remove(e1);
-        free(c);
-        e1 = next;
-    }
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->pagedir == NULL && t->fd_map == NULL && t->cwd == NULL)
+    return false;
+  list_push_back (&dead_list, &t->elem);
+  sema_up (&dead_sema);
+  return true;
 }
 
 /* Sets up the CPU for running user code in the current
@@ -292,51 +524,112 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
-static bool setup_stack (int argc, char* argv[], void **esp);
+static bool setup_stack (const struct start_info *info, void **esp);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
                           bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
-   Stores the executable's entry point into *EIP
-   and its initial stack pointer into *ESP.
-   Returns true if successful, false otherwise. */
-bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+/* A loadable segment of an executable, as load_segment() takes
+   it. */
+struct exec_segment
+  {
+    off_t file_page;            /* Page-aligned offset in the file. */
+    uint8_t *mem_page;          /* Page-aligned user address. */
+    uint32_t read_bytes;        /* Bytes to read from the file. */
+    uint32_t zero_bytes;        /* Bytes to zero after them. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* The validated layout of an executable: what is left of its
+   ELF headers once they have been checked. */
+struct exec_image
+  {
+    struct list_elem elem;      /* Element in exec_cache. */
+    block_sector_t inumber;     /* Executable's inode number. */
+    unsigned version;           /* Its inode version when parsed. */
+    int ref_cnt;                /* The cache, if in it, plus mappers. */
+    void (*entry) (void);       /* Entry point. */
+    int seg_cnt;                /* Number of segments. */
+    struct exec_segment *segs;  /* Segments. */
+  };
+
+/* Most executables whose layout is kept. */
+#define EXEC_CACHE_CNT 16
+
+/* Layouts of recently loaded executables, most recently used
+   first, so that launching the same program again does not parse
+   its headers again.  An entry is only used while the inode's
+   version matches, which a write to the file changes. */
+static struct list exec_cache;
+static size_t exec_cache_cnt;
+static struct lock exec_cache_lock;
+
+/* Initializes the child records, the reaper and the executable
+   layout cache. */
+void
+process_init (void)
 {
-  struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
-  struct file *file = NULL;
-  off_t file_ofs;
-  bool success = false;
-  int i;
+  hash_init (&child_records, child_hash, child_less, NULL);
+  lock_init (&child_lock);
+  list_init (&dead_list);
+  sema_init (&dead_sema, 0);
+  thread_create ("reaper", PRI_MIN, reaper, NULL);
+  list_init (&exec_cache);
+  lock_init (&exec_cache_lock);
+}
 
-  /*pointers to keep track of position in strtok_r*/
-  char* curr_arg;
-  char* remaining_args;
-  char *argv[MAX_ARGS];
-  int argc = 0;
-
-  /* go through all cli arguments, parsing using strotk_r*/
-  for(curr_arg = strtok_r((char*) file_name, " ", &remaining_args); 
-      curr_arg != NULL; curr_arg = strtok_r(NULL, " ", &remaining_args)){
-    argv[argc] = curr_arg;
-    argc++;
-  }
+/* Frees IMAGE. */
+static void
+free_image (struct exec_image *image)
+{
+  free (image->segs);
+  free (image);
+}
 
-  /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create ();
-  if (t->pagedir == NULL) 
-    goto done;
-  process_activate ();
-  /* Open executable file. */
-  file = filesys_open (file_name);
-  if (file == NULL) 
+/* Drops a reference to IMAGE, freeing it after the last.  Must be
+   called with exec_cache_lock held. */
+static void
+put_image (struct exec_image *image)
+{
+  ASSERT (image->ref_cnt > 0);
+  if (--image->ref_cnt == 0)
+    free_image (image);
+}
+
+/* Returns the cached layout of version VERSION of the executable
+   with inode number INUMBER, moving it to the front of the cache,
+   or a null pointer if there is none.  Must be called with
+   exec_cache_lock held. */
+static struct exec_image *
+find_image (block_sector_t inumber, unsigned version)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&exec_cache); e != list_end (&exec_cache);
+       e = list_next (e))
     {
-      printf ("load: %s: open failed\n", file_name);
-      goto done; 
+      struct exec_image *image = list_entry (e, struct exec_image, elem);
+      if (image->inumber == inumber && image->version == version)
+        {
+          list_remove (e);
+          list_push_front (&exec_cache, e);
+          return image;
+        }
     }
+  return NULL;
+}
+
+/* Reads and validates the ELF headers of FILE, named FILE_NAME,
+   and returns its layout in a new exec_image, or a null pointer
+   if FILE is not a loadable executable or memory runs out. */
+static struct exec_image *
+read_image (struct file *file, const char *file_name)
+{
+  struct exec_image *image;
+  struct Elf32_Ehdr ehdr;
+  off_t file_ofs;
+  int i;
 
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
@@ -348,9 +641,16 @@ load (const char *file_name, void (**eip) (void), void **esp)
       || ehdr.e_phnum > 1024) 
     {
       printf ("load: %s: error loading executable\n", file_name);
-      goto done; 
+      return NULL;
     }
 
+  image = malloc (sizeof *image);
+  if (image == NULL)
+    return NULL;
+  image->entry = (void (*) (void)) ehdr.e_entry;
+  image->seg_cnt = 0;
+  image->segs = NULL;
+
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
   for (i = 0; i < ehdr.e_phnum; i++) 
@@ -358,11 +658,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       struct Elf32_Phdr phdr;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        goto error;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        goto error;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -376,48 +676,160 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          goto error;
         case PT_LOAD:
           if (validate_segment (&phdr, file)) 
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+              struct exec_segment *seg;
               uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
+
+              seg = realloc (image->segs,
+                             (image->seg_cnt + 1) * sizeof *seg);
+              if (seg == NULL)
+                goto error;
+              image->segs = seg;
+              seg += image->seg_cnt++;
+              seg->writable = (phdr.p_flags & PF_W) != 0;
+              seg->file_page = phdr.p_offset & ~PGMASK;
+              seg->mem_page = (uint8_t *) (phdr.p_vaddr & ~PGMASK);
               if (phdr.p_filesz > 0)
                 {
                   /* Normal segment.
                      Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
+                  seg->read_bytes = page_offset + phdr.p_filesz;
+                  seg->zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz,
+                                               PGSIZE)
+                                     - seg->read_bytes);
                 }
               else 
                 {
                   /* Entirely zero.
                      Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                  seg->read_bytes = 0;
+                  seg->zero_bytes = ROUND_UP (page_offset + phdr.p_memsz,
+                                              PGSIZE);
                 }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
             }
           else
-            goto done;
+            goto error;
           break;
         }
     }
+  return image;
 
+ error:
+  free_image (image);
+  return NULL;
+}
 
+/* Adds IMAGE's segments to the current thread's supplemental
+   page table, backed by FILE.  Returns true if successful. */
+static bool
+map_image (struct file *file, const struct exec_image *image)
+{
+  int i;
 
-  /* Set up stack. */
-  if (!setup_stack (argc, argv, esp))
+  for (i = 0; i < image->seg_cnt; i++)
+    {
+      const struct exec_segment *seg = &image->segs[i];
+      if (!load_segment (file, seg->file_page, seg->mem_page,
+                         seg->read_bytes, seg->zero_bytes, seg->writable))
+        return false;
+    }
+  return true;
+}
+
+/* Maps executable FILE, named FILE_NAME, into the current thread
+   and stores its entry point into *EIP, taking its layout from
+   the cache if possible and adding it to the cache otherwise.
+   Returns true if successful, false otherwise. */
+static bool
+load_image (struct file *file, const char *file_name, void (**eip) (void))
+{
+  struct inode *inode = file_get_inode (file);
+  block_sector_t inumber = inode_get_inumber (inode);
+  /* Read before the headers, so that a write racing with parsing
+     leaves the cached layout with an out-of-date version. */
+  unsigned version = inode_get_version (inode);
+  struct exec_image *image;
+  bool success;
+
+  /* Take a reference to a cached layout, so that it can be mapped
+     without holding the lock even if it is evicted meanwhile. */
+  lock_acquire (&exec_cache_lock);
+  image = find_image (inumber, version);
+  if (image != NULL)
+    image->ref_cnt++;
+  lock_release (&exec_cache_lock);
+
+  if (image == NULL)
+    {
+      image = read_image (file, file_name);
+      if (image == NULL)
+        return false;
+      image->inumber = inumber;
+      image->version = version;
+      image->ref_cnt = 1;
+
+      /* Cache the layout, unless another process got there first. */
+      lock_acquire (&exec_cache_lock);
+      if (find_image (inumber, version) == NULL)
+        {
+          image->ref_cnt++;
+          list_push_front (&exec_cache, &image->elem);
+          if (++exec_cache_cnt > EXEC_CACHE_CNT)
+            {
+              struct list_elem *e = list_pop_back (&exec_cache);
+              put_image (list_entry (e, struct exec_image, elem));
+              exec_cache_cnt--;
+            }
+        }
+      lock_release (&exec_cache_lock);
+    }
+
+  *eip = image->entry;
+  success = map_image (file, image);
+
+  lock_acquire (&exec_cache_lock);
+  put_image (image);
+  lock_release (&exec_cache_lock);
+  return success;
+}
+
+/* Loads the ELF executable named by INFO's first argument into the
+   current thread, passing it INFO's arguments.
+   Stores the executable's entry point into *EIP
+   and its initial stack pointer into *ESP.
+   Returns true if successful, false otherwise. */
+bool
+load (const struct start_info *info, void (**eip) (void), void **esp) 
+{
+  struct thread *t = thread_current ();
+  const char *file_name = info->args;
+  struct file *file = NULL;
+  bool success = false;
+
+  /* Allocate and activate page directory. */
+  t->pagedir = pagedir_create ();
+  if (t->pagedir == NULL) 
+    goto done;
+  process_activate ();
+  /* Open executable file. */
+  file = filesys_open (file_name);
+  if (file == NULL) 
+    {
+      printf ("load: %s: open failed\n", file_name);
+      goto done; 
+    }
+
+  /* Map the executable's segments, parsing its headers only if
+     they are not already cached. */
+  if (!load_image (file, file_name, eip))
     goto done;
 
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
+  /* Set up stack. */
+  if (!setup_stack (info, esp))
+    goto done;
 
   success = true;
 
@@ -523,7 +935,7 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 /* Create a minimal stack by mapping a zeroed page at the top of
    user virtual memory. */ 
 static bool
-setup_stack (int argc, char* argv[], void **esp) 
+setup_stack (const struct start_info *info, void **esp) 
 {
   struct thread *t = thread_current(); 
   uint8_t *upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
@@ -536,24 +948,15 @@ setup_stack (int argc, char* argv[], void **esp)
     return false;
   }
 
-  //pin thes stack, can unpin it after
-  struct frame* f = pagedir_get_page(t->pagedir, spt_entry->upage);
-  f->pinned = true;
+  //pin the stack while arguments are pushed, unpin it after
+  frame_pin(t->pagedir, spt_entry->upage);
 
-  *esp = PHYS_BASE;
-  char* arg_pointers[argc];
-  int offset = 0;
-  //pushing args onto stack in reverse order
-  for(int i = argc - 1; i >= 0; i--){
-    //offset stack pointer with enough room for arg, offset length by 1 for null term
-    //using 128 as limit for strlen because of limit said in docs
-    offset = sizeof(char) * (strnlen(argv[i], 128) + 1);
-    *esp = *esp - offset;
-    //copy arg into stack
-    memcpy(*esp, argv[i], offset);
-    //copy that pointer into the args
-    arg_pointers[i] = *esp;
-  }
+  int argc = info->argc;
+  //the argument strings are already laid out as they go on the stack,
+  //first argument lowest, so push them all at once
+  char* args = (char*) PHYS_BASE - info->args_len;
+  memcpy(args, info->args, info->args_len);
+  *esp = args;
   //round the current stack position down by 4 to align with words
   *esp = round_word_down(*esp);
   //offset word for null pointer sentinel
@@ -562,7 +965,7 @@ setup_stack (int argc, char* argv[], void **esp)
   //push pointers onto stack, again in reverse order
   for(int i = argc - 1; i >= 0; i--){
     *esp = *esp - sizeof(char*);
-    *((char**) *esp) = arg_pointers[i];
+    *((char**) *esp) = args + info->argv_ofs[i];
   }
   //now push pointer to first arg, argc, and null pointer for return address
   //first arg
@@ -575,22 +978,66 @@ setup_stack (int argc, char* argv[], void **esp)
   *esp = *esp - sizeof(int*);
   *((int**) *esp) = NULL;
 
+  frame_unpin(t->pagedir, spt_entry->upage);
   return true;
 }
 
 /*Function used to find a processs_file of given fd under thread
   returns NULL if no such file exists*/
 struct process_file* find_file(struct thread* t, int fd){
-  struct process_file* curr_file;
-  if(list_empty(&t->opened_files))
+  if(t->fd_map == NULL || fd < FD_BASE
+     || (size_t)(fd - FD_BASE) >= bitmap_size(t->fd_map))
     return NULL;
-  for(struct list_elem* curr = list_front(&t->opened_files);
-    curr != NULL; curr=curr->next){
-    curr_file = list_entry(curr, struct process_file, elem);
-    if(curr_file->fd == fd)
-      return curr_file;
+  return t->fd_table[fd - FD_BASE];
+}
+
+/*Doubles the capacity of t's fd table, starting at FD_INIT_CNT,
+  returns false if out of memory*/
+static bool
+grow_fd_table(struct thread* t){
+  size_t old_cnt = t->fd_map != NULL ? bitmap_size(t->fd_map) : 0;
+  size_t new_cnt = old_cnt > 0 ? old_cnt * 2 : FD_INIT_CNT;
+  struct bitmap* map = bitmap_create(new_cnt);
+  struct process_file** table = realloc(t->fd_table,
+                                        new_cnt * sizeof *table);
+  if(map == NULL || table == NULL){
+    bitmap_destroy(map);
+    //realloc leaves the old table alone on failure
+    if(table != NULL)
+      t->fd_table = table;
+    return false;
   }
-  return NULL;
+  for(size_t i = 0; i < old_cnt; i++)
+    bitmap_set(map, i, bitmap_test(t->fd_map, i));
+  memset(table + old_cnt, 0, (new_cnt - old_cnt) * sizeof *table);
+  if(t->fd_map != NULL)
+    bitmap_destroy(t->fd_map);
+  t->fd_map = map;
+  t->fd_table = table;
+  return true;
+}
+
+/*Function used to give f the lowest free fd of thread t, growing the
+  table when it is full, returns the fd or -1 if out of memory*/
+int add_file(struct thread* t, struct process_file* f){
+  size_t idx = BITMAP_ERROR;
+  if(t->fd_map != NULL)
+    idx = bitmap_scan_and_flip(t->fd_map, 0, 1, false);
+  if(idx == BITMAP_ERROR){
+    if(!grow_fd_table(t))
+      return -1;
+    idx = bitmap_scan_and_flip(t->fd_map, 0, 1, false);
+  }
+  t->fd_table[idx] = f;
+  f->fd = idx + FD_BASE;
+  return f->fd;
+}
+
+/*Function used to free fd of thread t so it can be handed out again*/
+void remove_file(struct thread* t, int fd){
+  ASSERT(find_file(t, fd) != NULL);
+  t->fd_table[fd - FD_BASE] = NULL;
+  bitmap_reset(t->fd_map, fd - FD_BASE);
 }
 
 /*Function used to determine a file f is an executable*/
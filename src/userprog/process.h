@@ -6,18 +6,25 @@
 struct process_file{
     int fd;                     /*File descriptor for process' file*/
     struct file* file;          /*pointer to file for process*/
-    struct list_elem elem;      /*list elem used to keep track of opened files*/
+    struct dir* dir;            /*directory for readdir, NULL if not a directory*/
 };
 
+void process_init (void);
 tid_t process_execute (const char *file_name);
 int process_wait (tid_t);
+tid_t process_wait_any (int *exit_code);
 void process_exit (void);
+bool process_reap_later (struct thread *);
 void process_activate (void);
 
+/*Lowest fd handed out for files, below it are the console fds*/
+#define FD_BASE 2
+
 struct process_file* find_file(struct thread* t, int fd);   /*Function used to find a file of given fd under thread t*/
+int add_file(struct thread* t, struct process_file* f);     /*Function used to give f the lowest free fd of thread t*/
+void remove_file(struct thread* t, int fd);                 /*Function used to free fd of thread t*/
 
 bool is_file_exe(struct file* f);       /*Function used to determine if file f is an executable file*/
 
-void free_children(struct list *child_list); /*free all the children in the current thread's child_list*/
 
 #endif /* userprog/process.h */
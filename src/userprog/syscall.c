@@ -4,10 +4,13 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include <limits.h>
 #include <stddef.h>
 #include "kernel/stdio.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
+#include "filesys/directory.h"
 #include "userprog/process.h"
 #include "threads/synch.h"
 #include "threads/malloc.h"
@@ -18,32 +21,57 @@
 #include "vm/page.h"
 #include "vm/frame.h"
 #include "vm/swap.h"
-
-/*Mapping each syscall to their respective function*/
-static int (*handlers[])(uint8_t* stack) = {
-  [SYS_HALT]halt,
-  [SYS_EXIT]syscall_exit,
-  [SYS_EXEC]exec,
-  [SYS_WAIT]wait,
-  [SYS_CREATE]create,
-  [SYS_REMOVE]remove,
-  [SYS_OPEN]open, 
-  [SYS_FILESIZE]filesize,
-  [SYS_READ]read,
-  [SYS_WRITE]write,
-  [SYS_SEEK]seek,
-  [SYS_TELL]tell,
-  [SYS_CLOSE]close,
-  [SYS_MMAP]mmap,
-  [SYS_MUNMAP]munmap
+#include <iovec.h>
+
+/*Most argument words any syscall takes*/
+#define MAX_ARGS 4
+
+/*Mapping each syscall to its handler and the number of argument words
+the handler reads, so the dispatcher can copy them all in at once*/
+static const struct syscall {
+  int (*handler)(uint8_t* args);
+  int arg_cnt;
+  const char* name;
+} syscalls[] = {
+  [SYS_HALT] = {halt, 0, "halt"},
+  [SYS_EXIT] = {syscall_exit, 1, "exit"},
+  [SYS_EXEC] = {exec, 1, "exec"},
+  [SYS_WAIT] = {wait, 1, "wait"},
+  [SYS_CREATE] = {create, 2, "create"},
+  [SYS_REMOVE] = {remove, 1, "remove"},
+  [SYS_OPEN] = {open, 1, "open"},
+  [SYS_FILESIZE] = {filesize, 1, "filesize"},
+  [SYS_READ] = {read, 3, "read"},
+  [SYS_WRITE] = {write, 3, "write"},
+  [SYS_SEEK] = {seek, 2, "seek"},
+  [SYS_TELL] = {tell, 1, "tell"},
+  [SYS_CLOSE] = {close, 1, "close"},
+  [SYS_MMAP] = {mmap, 2, "mmap"},
+  [SYS_MUNMAP] = {munmap, 1, "munmap"},
+  [SYS_CHDIR] = {chdir, 1, "chdir"},
+  [SYS_MKDIR] = {mkdir, 1, "mkdir"},
+  [SYS_READDIR] = {readdir, 2, "readdir"},
+  [SYS_ISDIR] = {isdir, 1, "isdir"},
+  [SYS_INUMBER] = {inumber, 1, "inumber"},
+  [SYS_COPY_RANGE] = {copy_range, 3, "copy_range"},
+  [SYS_PREAD] = {pread, 4, "pread"},
+  [SYS_PWRITE] = {pwrite, 4, "pwrite"},
+  [SYS_READV] = {readv, 3, "readv"},
+  [SYS_WRITEV] = {writev, 3, "writev"},
+  [SYS_FILEBLOCKS] = {fileblocks, 1, "fileblocks"},
+  [SYS_FSYNC] = {fsync, 1, "fsync"},
+  [SYS_WAIT_ANY] = {wait_any, 1, "wait_any"},
+  [SYS_YIELD] = {yield, 0, "yield"}
 };
 
-/*Lock used to handle filesys concurrency*/
-struct lock file_lock;
+/*Number of entries in syscalls[] and in each table of statistics*/
+#define SYSCALL_CNT (sizeof syscalls / sizeof *syscalls)
 
-struct lock error_lock;
+/*Calls and cycles spent in each syscall, across all processes*/
+static struct syscall_stat global_stats[SYSCALL_CNT];
 
-bool raised_error = false;
+/*Print each process's statistics when it exits, set by -sc*/
+bool syscall_stats_per_process;
 
 static void syscall_handler (struct intr_frame *);
 struct mmap_file* find_mmap_file(struct thread *t, mapid_t mapid);
@@ -52,108 +80,258 @@ struct mmap_file* find_mmap_file(struct thread *t, mapid_t mapid);
 void
 syscall_init (void) 
 {
-  //have to init lock before register, since register calls syscall handler
-  lock_init(&file_lock);
-  lock_init(&error_lock);
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
 	
 
-/* Reads a byte at user virtual address UADDR.
-   UADDR must be below PHYS_BASE.
-   Returns the byte value if successful, -1 if a segfault
-   occurred. */
-static int
-get_user (const uint8_t *uaddr)
-{
+/*Returns true if the size bytes at uaddr are non-null and lie wholly
+below PHYS_BASE, without checking whether they are mapped*/
+static bool
+user_range_ok(const void* uaddr, size_t size){
+  return uaddr != NULL && is_user_vaddr(uaddr)
+         && size <= (size_t)((const uint8_t*)PHYS_BASE - (const uint8_t*)uaddr);
+}
+
+/*Copies size bytes from src to dst a word at a time, where one of
+them is user memory that user_range_ok() has accepted. A page that
+turns out to be bad makes page_fault() resume at label 1 with eax set
+to -1 instead of killing the process. Returns true if successful*/
+static bool
+fault_safe_copy(void* dst, const void* src, size_t size){
+  struct thread* t = thread_current();
+  size_t words = size / sizeof(uint32_t);
+  size_t bytes = size % sizeof(uint32_t);
   int result;
-  asm ("movl $1f, %0; movzbl %1, %0; 1:"
-       : "=&a" (result) : "m" (*uaddr));
-  return result;
+
+  t->in_user_copy = true;
+  asm volatile ("movl $1f, %%eax\n\t"
+                "rep movsl\n\t"
+                "movl %4, %%ecx\n\t"
+                "rep movsb\n"
+                "1:"
+                : "=&a" (result), "+D" (dst), "+S" (src), "+c" (words)
+                : "g" (bytes)
+                : "memory");
+  t->in_user_copy = false;
+  return result != -1;
+}
+
+/*Flags a bad user pointer, which makes the syscall handler kill the
+process once the handler returns*/
+static void
+raise_error(void){
+  thread_current()->syscall_error = true;
 }
- 
 
 /*copy data of size size to dst_ from usrc_.  
-return false if an error occured, otherwise true*/
+return false if an error occured, otherwise true. A bad usrc_ also
+raises an error, so the process is killed*/
 bool copy_in (void* dst_, const void* usrc_, size_t size){
   ASSERT (dst_ != NULL || size == 0);
-  ASSERT (usrc_ != NULL || size == 0);
-  
-  struct thread* curr = thread_current();
-  uint8_t* dst = dst_;
-  const uint8_t* usrc = usrc_;
-  if(!is_user_vaddr(usrc) || !is_user_vaddr(usrc + size) || usrc == NULL){
+
+  if(!user_range_ok(usrc_, size) || !fault_safe_copy(dst_, usrc_, size)){
+    raise_error();
     return false;
   }
-  // Checks if page exists to a mapped physical memory for each byte
-  for(int i = 0; i <= 3; i++){
-    if(pagedir_get_page(curr->pagedir, usrc + i) == NULL){
-      return false;
-    }
-  }
+  return true;
+}
 
+/*copy data of size size from src_ to user memory at udst_, checking
+once per page that the page is not read-only, since the kernel's own
+writes ignore read-only user mappings. Pages with no entry yet are
+left to the fault handler, which grows the stack or fails the copy.
+return false if an error occured, otherwise true. A bad udst_ also
+raises an error*/
+bool copy_out (void* udst_, const void* src_, size_t size){
+  struct thread* t = thread_current();
+  ASSERT (src_ != NULL || size == 0);
 
-  for(; size > 0; size--, dst++, usrc++){
-    int curr = get_user(usrc);
-    if(curr == -1){
+  if(!user_range_ok(udst_, size)){
+    raise_error();
+    return false;
+  }
+  for(uint8_t* page = pg_round_down(udst_);
+      page < (uint8_t*)udst_ + size; page += PGSIZE){
+    struct sup_pt_list* spte = sup_pt_find(&t->spt, page);
+    if(spte != NULL && !spte->writable){
+      raise_error();
       return false;
     }
-    *dst = curr;
+  }
+  if(!fault_safe_copy(udst_, src_, size)){
+    raise_error();
+    return false;
   }
   return true;
 }
 
-/*Function used to determine if a pointer and its following range btres 
-are valid addresses for syscalls*/
+/*Function used to determine if a pointer and its following range bytes
+are valid addresses for syscalls, checking each page once: a page is
+valid if it is mapped or will be loaded on demand*/
 bool valid_esp(void* ptr, int range){
   struct thread* curr = thread_current();
-  for(int i = 0; i <= range; i++){
-    if(ptr == NULL) {
-      return false;
-    }
-    if(!is_user_vaddr(ptr + i) || ptr == NULL){
+  if(range < 0 || !user_range_ok(ptr, (size_t)range + 1))
+    return false;
+  for(uint8_t* page = pg_round_down(ptr);
+      page <= (uint8_t*)ptr + range; page += PGSIZE){
+    if(pagedir_get_page(curr->pagedir, page) == NULL
+       && sup_pt_find(&curr->spt, page) == NULL)
       return false;
-    }
-    if(pagedir_get_page(curr->pagedir, ptr + i) == NULL){
+  }
+  return true;
+}
+
+
+/*Maximum number of user pages pinned at once by pinned_file_io() and
+pinned_putbuf()*/
+#define PIN_CHUNK_PAGES 8
+
+/*Transfers SIZE bytes between FILE at offset OFS and user BUFFER
+(into the file if TO_FILE). Each chunk of the buffer is pinned first,
+so the inode layer can move whole sectors straight between the disk
+and user memory without faulting; chunking keeps a large buffer from
+pinning every frame. The file position is not changed. Returns the
+number of bytes transferred, or -1 if BUFFER is not valid user memory*/
+static int
+pinned_file_io(struct file* file, uint8_t* buffer, int size, off_t ofs,
+               bool to_file){
+  int total = 0;
+  while(total < size){
+    uint8_t* chunk = buffer + total;
+    int chunk_size = PIN_CHUNK_PAGES * PGSIZE - pg_ofs(chunk);
+    if(chunk_size > size - total)
+      chunk_size = size - total;
+    if(!sup_pin_buffer(chunk, chunk_size, !to_file))
+      return -1;
+    int done = to_file ? file_write_at(file, chunk, chunk_size, ofs + total)
+                       : file_read_at(file, chunk, chunk_size, ofs + total);
+    sup_unpin_buffer(chunk, chunk_size);
+    total += done;
+    if(done < chunk_size)
+      break;
+  }
+  return total;
+}
+
+/*Writes SIZE bytes of user BUFFER to the console, pinning at most
+PIN_CHUNK_PAGES pages of it at a time since the serial driver copies
+it with interrupts off. Returns false if BUFFER is not valid user
+memory, after writing whatever came before the bad chunk*/
+static bool
+pinned_putbuf(const uint8_t* buffer, size_t size){
+  size_t total = 0;
+  while(total < size){
+    const uint8_t* chunk = buffer + total;
+    size_t chunk_size = PIN_CHUNK_PAGES * PGSIZE - pg_ofs(chunk);
+    if(chunk_size > size - total)
+      chunk_size = size - total;
+    if(!sup_pin_buffer(chunk, chunk_size, false))
       return false;
-    }
+    putbuf((const char*)chunk, chunk_size);
+    sup_unpin_buffer(chunk, chunk_size);
+    total += chunk_size;
   }
   return true;
 }
 
+/*Returns the processor's time-stamp counter*/
+static inline uint64_t
+rdtsc(void){
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/*Adds calls and cycles to stat*/
+static void
+add_stat(struct syscall_stat* stat, unsigned calls, uint64_t cycles){
+  stat->cnt += calls;
+  stat->cycles += cycles;
+  if(cycles > stat->max)
+    stat->max = cycles;
+}
+
+/*Adds calls and cycles for syscall nr to the global statistics and to
+those of thread t if it keeps any. Calls are counted on entry and
+cycles on return, so calls that never return, like exit, still count*/
+static void
+count_call(unsigned nr, struct thread* t, unsigned calls, uint64_t cycles){
+  //other processes update the global table too
+  enum intr_level old_level = intr_disable();
+  add_stat(&global_stats[nr], calls, cycles);
+  intr_set_level(old_level);
+  if(t->syscall_stats != NULL)
+    add_stat(&t->syscall_stats[nr], calls, cycles);
+}
+
+/*Prints one line for each syscall in stats that was called, each
+starting with prefix*/
+static void
+print_stats(const char* prefix, const struct syscall_stat* stats){
+  for(size_t i = 0; i < SYSCALL_CNT; i++){
+    const struct syscall_stat* s = &stats[i];
+    if(s->cnt == 0)
+      continue;
+    printf("%s%s: %llu calls, %llu cycles, %llu max\n", prefix,
+           syscalls[i].name, s->cnt, s->cycles, s->max);
+  }
+}
+
+/*Prints the syscall statistics of process t, if it kept any*/
+void
+syscall_print_process_stats(struct thread* t){
+  char prefix[sizeof t->name + 16];
+  if(t->syscall_stats == NULL)
+    return;
+  snprintf(prefix, sizeof prefix, "%s: syscall ", t->name);
+  print_stats(prefix, t->syscall_stats);
+}
+
+/*Prints the syscall statistics of all processes*/
+void
+syscall_print_stats(void){
+  uint64_t calls = 0;
+  for(size_t i = 0; i < SYSCALL_CNT; i++)
+    calls += global_stats[i].cnt;
+  printf("Syscalls: %llu calls\n", calls);
+  print_stats("Syscall ", global_stats);
+}
 
 static void
 syscall_handler (struct intr_frame *f) 
 { 
+  struct thread* t = thread_current();
   unsigned interrupt_number;
-  thread_current()->curr_esp = f->esp;
-  
-  // Check if the 4 bytes is in user virtual address space and has an existing
-  // page associated with it, if all good put it in interrupt_number
-  if(!valid_esp((void*) f->esp, 3))
-    proc_exit(-1);
+  uint32_t args[MAX_ARGS];
+  const struct syscall* sc;
+  t->curr_esp = f->esp;
   
-  //copy in the interrupt number from the stack
-  if(!copy_in(&interrupt_number, f->esp, sizeof(interrupt_number))) {
-    proc_exit(-1);
-  }
-  //if interrupt number is valid, call its function and grab return code
-  if(interrupt_number < sizeof(handlers) / sizeof(handlers[0])){
-    //setting return code to code given by respective handler
-    f->eax = handlers[interrupt_number](f->esp + sizeof(unsigned));
-    //if an important error occured, resest the flag and exit
-    if(raised_error){
-      lock_acquire(&error_lock);
-      raised_error = false;
-      lock_release(&error_lock);
-      proc_exit(-1);
-    }
-  }else{
-    //otherwise return code is -1
+  //copy in the interrupt number from the stack, a bad esp faults inside
+  //the copy instead of being checked page by page
+  if(!copy_in(&interrupt_number, f->esp, sizeof(interrupt_number))
+     || interrupt_number >= SYSCALL_CNT
+     || syscalls[interrupt_number].handler == NULL){
     f->eax = -1;
     proc_exit(-1);
   }
+  //then all of its arguments in one copy, so the handlers read them
+  //from the kernel
+  sc = &syscalls[interrupt_number];
+  if(!copy_in(args, (uint32_t*)f->esp + 1, sc->arg_cnt * sizeof(uint32_t)))
+    proc_exit(-1);
+
+  //setting return code to code given by respective handler, timing it
+  //for the statistics
+  if(syscall_stats_per_process && t->syscall_stats == NULL)
+    t->syscall_stats = calloc(SYSCALL_CNT, sizeof *t->syscall_stats);
+  count_call(interrupt_number, t, 1, 0);
+  uint64_t start = rdtsc();
+  f->eax = sc->handler((uint8_t*)args);
+  count_call(interrupt_number, t, 0, rdtsc() - start);
+  //if an important error occured, exit
+  if(t->syscall_error)
+    proc_exit(-1);
 }
 
 /*handler for SYS_HALT*/
@@ -164,58 +342,37 @@ int halt (uint8_t* stack UNUSED){
 /*HANDLER FOR SYS_EXIT*/
 int syscall_exit(uint8_t* stack){
   int status;
-  if(!copy_in(&status, stack, sizeof(int)))
-    status = -1;
+  memcpy(&status, stack, sizeof(int));
   proc_exit(status);
   return status;
 }
 
 void proc_exit(int status){
-  struct thread* cur = thread_current();
-  cur->exit_code = status;
-  struct child_process *child = find_child_from_id(cur->tid, &cur->parent->child_processes);
-  child->exit_code = status;
-  if (status == -1) {
-    child->is_alive = false;
-  }
+  thread_current()->exit_code = status;
   thread_exit();
 }
 
 /*HANLDER FOR SYS_EXEC*/
 int exec(uint8_t* stack){
-  struct thread* cur = thread_current();
   tid_t pid;
   char* cmd_line;
-  if(!copy_in(&cmd_line, stack, sizeof(char*))) {
-    lock_acquire(&error_lock);
-    raised_error = true;
-    lock_release(&error_lock);
-    return -1;
-  }
+  memcpy(&cmd_line, stack, sizeof(char*));
   // Checks if page exists to a mapped physical memory for every byte in cmd_line
   if(!valid_esp((void*)cmd_line, 3)){
   // Checks if page exists to a mapped physical memory 
   // for every byte in cmd_line
-    lock_acquire(&error_lock);
-    raised_error = true;
-    lock_release(&error_lock);
+    raise_error();
     return -1;
   }
 
   pid = process_execute(cmd_line);
-  struct child_process *child = find_child_from_id(pid, &cur->child_processes);
-  sema_down(&child->t->exec_sema);
-  if (!child->load_success) {
-    return -1;
-  }
-  return pid;
+  return pid == TID_ERROR ? -1 : pid;
 }
 
 /*Handler for SYS_WAIT*/
 int wait(uint8_t* stack){
   tid_t pid;
-  if(!copy_in(&pid, stack, sizeof(tid_t)))
-    return -1;
+  memcpy(&pid, stack, sizeof(tid_t));
   int status = process_wait(pid);
   return status;
 }
@@ -227,25 +384,19 @@ int create(uint8_t* stack){
   unsigned inital_size;
   uint8_t* curr_pos = stack;
   //copy in arguments
-  if(!copy_in(&file_name, curr_pos, sizeof(char*)))
-    return -1;
+  memcpy(&file_name, curr_pos, sizeof(char*));
   curr_pos += sizeof(char*);
 
-  if(!copy_in(&inital_size, curr_pos, sizeof(unsigned)))
-    return -1;
+  memcpy(&inital_size, curr_pos, sizeof(unsigned));
   
   //checking for null filename or invalid ptr
   if((int*) file_name == NULL || !valid_esp((void*)file_name, 0)) {
-    lock_acquire(&error_lock);
-    raised_error = true;
-    lock_release(&error_lock);
+    raise_error();
     return -1;
   }
 
-  //acquire lock and call filesys_create
-  lock_acquire(&file_lock);
+  //filesys synchronizes per directory and per inode
   bool success = filesys_create(file_name, inital_size);
-  lock_release(&file_lock);
   
   return (int)success;
 }
@@ -254,12 +405,8 @@ int create(uint8_t* stack){
 int remove(uint8_t* stack){
   //get the file name
   const char* file_name;
-  if(!copy_in(&file_name, stack, sizeof(char*)))
-    return false;
-  //acquire lock, remove then release
-  lock_acquire(&file_lock);
+  memcpy(&file_name, stack, sizeof(char*));
   bool success = filesys_remove(file_name);
-  lock_release(&file_lock);
   return (int)success;
 }
 
@@ -267,24 +414,18 @@ int remove(uint8_t* stack){
 int open(uint8_t* stack){
   //copy filename from stack
   char* file_name;
-  if (!copy_in(&file_name, stack, sizeof(char*)))
-    return -1;
+  memcpy(&file_name, stack, sizeof(char*));
 
   // Checks if the file name goes into unmapped memory
   if((int*) file_name == NULL || !valid_esp((void*)file_name, 3)){
-    lock_acquire(&error_lock);
-    raised_error = true;
-    lock_release(&error_lock);
+    raise_error();
     return -1;
   }
   
   //open file
-  lock_acquire(&file_lock);
   struct file* f = filesys_open(file_name);
-  if(f == NULL){
-    lock_release(&file_lock);
+  if(f == NULL)
     return -1;
-  }
   bool is_exe = is_file_exe(f);
   if(is_exe){
     //deny writing if its an exe
@@ -295,19 +436,26 @@ int open(uint8_t* stack){
   struct process_file* new_file = malloc(sizeof(struct process_file));
   if(new_file == NULL){
     file_close(f);
-    lock_release(&file_lock);
     return -1;
   }
-  struct thread* t = thread_current();
-  //asign its fd, its file, and increment thread's fd counter
-  new_file->fd = t->curr_fd+1;
+  //directories also get a struct dir to keep their readdir position
+  new_file->dir = NULL;
+  if(inode_is_dir(file_get_inode(f))){
+    new_file->dir = dir_open(inode_reopen(file_get_inode(f)));
+    if(new_file->dir == NULL){
+      file_close(f);
+      free(new_file);
+      return -1;
+    }
+  }
+  //give the file the lowest free fd
   new_file->file = f;
-  t->curr_fd++; 
-  //add the file to process' list of files
-  list_push_front(&t->opened_files, &new_file->elem);
-  //release the lock for the file system
-  lock_release(&file_lock);
-  //return assigned fd
+  if(add_file(thread_current(), new_file) < 0){
+    dir_close(new_file->dir);
+    file_close(f);
+    free(new_file);
+    return -1;
+  }
   return new_file->fd;
 }
 
@@ -315,20 +463,142 @@ int open(uint8_t* stack){
 int filesize(uint8_t* stack){
   //copy in fd
   int fd;
-  if(!copy_in(&fd, stack, sizeof(int)))
-    return 0;
+  memcpy(&fd, stack, sizeof(int));
 
-  //acquire lock, file from fd, then get size
-  lock_acquire(&file_lock);
+  //find file from fd, then get size
   struct process_file* f = find_file(thread_current(), fd);
-  if(f == NULL){
-    lock_release(&file_lock);
+  if(f == NULL)
     return 0;
+  return (int)file_length(f->file);
+}
+
+/*Handler for SYS_CHDIR*/
+int chdir(uint8_t* stack){
+  const char* dir_name;
+  memcpy(&dir_name, stack, sizeof(char*));
+  if(dir_name == NULL || !valid_esp((void*)dir_name, 0)){
+    raise_error();
+    return false;
+  }
+  return (int)filesys_chdir(dir_name);
+}
+
+/*Handler for SYS_MKDIR*/
+int mkdir(uint8_t* stack){
+  const char* dir_name;
+  memcpy(&dir_name, stack, sizeof(char*));
+  if(dir_name == NULL || !valid_esp((void*)dir_name, 0)){
+    raise_error();
+    return false;
+  }
+  return (int)filesys_mkdir(dir_name);
+}
+
+/*Handler for SYS_READDIR, copies the next entry name of directory fd
+into the user's buffer of READDIR_MAX_LEN + 1 bytes*/
+int readdir(uint8_t* stack){
+  uint8_t* curr_pos = stack;
+  int fd;
+  char* name;
+  char kname[NAME_MAX + 1];
+
+  //copy in args
+  memcpy(&fd, curr_pos, sizeof(int));
+  curr_pos += sizeof(int);
+  memcpy(&name, curr_pos, sizeof(char*));
+
+  struct process_file* f = find_file(thread_current(), fd);
+  if(f == NULL || f->dir == NULL || !dir_readdir(f->dir, kname))
+    return false;
+
+  return copy_out(name, kname, sizeof kname);
+}
+
+/*Handler for SYS_ISDIR*/
+int isdir(uint8_t* stack){
+  int fd;
+  memcpy(&fd, stack, sizeof(int));
+  struct process_file* f = find_file(thread_current(), fd);
+  return f != NULL && f->dir != NULL;
+}
+
+/*Handler for SYS_INUMBER*/
+int inumber(uint8_t* stack){
+  int fd;
+  memcpy(&fd, stack, sizeof(int));
+  struct process_file* f = find_file(thread_current(), fd);
+  if(f == NULL)
+    return -1;
+  return (int)inode_get_inumber(file_get_inode(f->file));
+}
+
+/*Handler for SYS_FILEBLOCKS, returns the number of disk sectors
+allocated to the file, which is less than its size in sectors if
+the file has holes*/
+int fileblocks(uint8_t* stack){
+  int fd;
+  memcpy(&fd, stack, sizeof(int));
+  struct process_file* f = find_file(thread_current(), fd);
+  if(f == NULL)
+    return -1;
+  return (int)inode_sector_cnt(file_get_inode(f->file));
+}
+
+/*Handler for SYS_FSYNC, returns 0 once the file's writes are on
+disk, or -1 for a bad fd*/
+int fsync(uint8_t* stack){
+  int fd;
+  memcpy(&fd, stack, sizeof(int));
+  struct process_file* f = find_file(thread_current(), fd);
+  if(f == NULL)
+    return -1;
+  file_sync(f->file);
+  return 0;
+}
+
+/*Handler for SYS_WAIT_ANY, reaps whichever child exits first and
+stores its exit status unless status is NULL. Returns its pid, or -1
+if there are no children left to wait for*/
+int wait_any(uint8_t* stack){
+  int* status;
+  int exit_code;
+  memcpy(&status, stack, sizeof(int*));
+  tid_t pid = process_wait_any(&exit_code);
+  if(pid == TID_ERROR)
+    return -1;
+  if(status != NULL && !copy_out(status, &exit_code, sizeof exit_code))
+    return -1;
+  return pid;
+}
+
+/*Handler for SYS_YIELD, lets the next ready thread of at least the
+same priority run*/
+int yield(uint8_t* stack UNUSED){
+  thread_yield();
+  return 0;
+}
+
+/*Fills up to size bytes of the user buffer with console input,
+waiting only until the first byte arrives and then taking whatever
+is already queued, up to and including a newline. Returns the number
+of bytes read, or -1 if the buffer is bad*/
+static int
+read_stdin(uint8_t* buffer, unsigned size){
+  uint8_t kbuf[128];
+  unsigned total = 0;
+
+  while(total < size){
+    unsigned chunk = size - total < sizeof kbuf ? size - total : sizeof kbuf;
+    size_t n = input_read(kbuf, chunk, total == 0);
+    if(n == 0)
+      break;
+    if(!copy_out(buffer + total, kbuf, n))
+      return -1;
+    total += n;
+    if(kbuf[n - 1] == '\n')
+      break;
   }
-  int size = (int)file_length(f->file);
-  //release lock and return size
-  lock_release(&file_lock);
-  return size;
+  return total;
 }
 
 /*Handler for SYS_READ*/
@@ -338,44 +608,37 @@ int read(uint8_t* stack){
   unsigned size;
   uint8_t* curr_pos = stack;
   //collect args
-  if(!copy_in(&fd, curr_pos, sizeof(int)))
-    return -1;
+  memcpy(&fd, curr_pos, sizeof(int));
   curr_pos += sizeof(int);
   
-  if(!copy_in(&buffer, curr_pos, sizeof(void*)))
-    return -1;
+  memcpy(&buffer, curr_pos, sizeof(void*));
   curr_pos += sizeof(void*);
-  if(!copy_in(&size, curr_pos, sizeof(unsigned)))
-    return -1;
+  memcpy(&size, curr_pos, sizeof(unsigned));
 
   if((!is_user_vaddr(buffer) || buffer == NULL)){
-    lock_acquire(&error_lock);
-    raised_error = true;
-    lock_release(&error_lock);
+    raise_error();
     return -1;
   }
 
   if(fd == STDOUT_FILENO){
     return -1;
   }else if(fd == STDIN_FILENO){
-    return (int) input_getc();
+    return read_stdin(buffer, size);
   }
 
-  //acquire lock, find file and read
+  //find file and read, the inode serializes concurrent access
   struct thread* t = thread_current();
 
-  lock_acquire(&file_lock);
   struct process_file* f = find_file(t, fd);
-  if(f == NULL){
-    lock_release(&file_lock);
+  if(f == NULL || f->dir != NULL)
     return -1;
-  }
 
-  struct frame* mem_frame = frame_get(pagedir_get_page(t->pagedir, pg_round_down(stack)));
-  mem_frame->pinned = true;
-  int read_size = file_read(f->file, buffer, (off_t) size);
-  mem_frame->pinned = false;
-  lock_release(&file_lock);
+  off_t pos = file_tell(f->file);
+  int read_size = pinned_file_io(f->file, buffer, size, pos, false);
+  if(read_size < 0){
+    raise_error();
+  }else
+    file_seek(f->file, pos + read_size);
   return read_size;
 }
 
@@ -387,40 +650,33 @@ int write(uint8_t* stack){
   int size;
 
   //copy in respective arguments, checking for valid addresses
-  if(!copy_in(&fd, (int*)curr_address, sizeof(int)))
-    return -1;
+  memcpy(&fd, (int*)curr_address, sizeof(int));
   curr_address += sizeof(int);
-  if(!copy_in(&buffer, (char**)curr_address,sizeof(char*)))
-    return -1;
+  memcpy(&buffer, (char**)curr_address, sizeof(char*));
   curr_address += sizeof(char*);
-  if(!copy_in(&size, (int*)curr_address, sizeof(int)))
-    return -1;
+  memcpy(&size, (int*)curr_address, sizeof(int));
 
   // Checks if the buffer goes into unmapped memory
-  if(!valid_esp((void*)buffer, 0)) {
-    lock_acquire(&error_lock);
-    raised_error = true;
-    lock_release(&error_lock);
+  if(size < 0 || !valid_esp((void*)buffer, size > 0 ? size - 1 : 0)) {
+    raise_error();
     return -1;
   }
   
 
-  //if to stdout, just put to the buffer
+  //if to stdout, queue it for the console a pinned chunk at a time
   if(fd == STDOUT_FILENO){
-    putbuf(buffer, size);
+    if(!pinned_putbuf((const uint8_t*)buffer, size)){
+      raise_error();
+      return -1;
+    }
     return size;
   }
-  //acquire lock for filesys and find file
-  lock_acquire(&file_lock);
+  //find file, the inode serializes concurrent access
   struct thread* t = thread_current();
   struct process_file* f = find_file(t, fd);
-  if(f == NULL){
-    lock_release(&file_lock);
+  if(f == NULL || f->dir != NULL)
     return -1;
-  }
 
-  struct frame* mem_frame = frame_get(pagedir_get_page(t->pagedir, pg_round_down(stack)));
-  mem_frame->pinned = true;
   int write_size = 0;
   if(is_file_exe(f->file)){
     //if file is an executable, check if what we're writing will change 
@@ -431,11 +687,14 @@ int write(uint8_t* stack){
       write_size = size;
     }
   }else{
-    //write to file, then release lock
-    write_size = (int)file_write(f->file, buffer, size);
+    //write to file
+    off_t pos = file_tell(f->file);
+    write_size = pinned_file_io(f->file, (uint8_t*)buffer, size, pos, true);
+    if(write_size < 0){
+      raise_error();
+    }else
+      file_seek(f->file, pos + write_size);
   }
-  mem_frame->pinned = false;
-  lock_release(&file_lock);
   return write_size;
   
 }
@@ -446,24 +705,17 @@ int seek(uint8_t* stack){
   int fd;
   unsigned position;
   uint8_t* curr_pos = stack;
-  if(!copy_in(&fd, curr_pos, sizeof(int)))
-    return -1;
+  memcpy(&fd, curr_pos, sizeof(int));
   
   curr_pos += sizeof(int);
 
-  if(!copy_in(&position, curr_pos, sizeof(unsigned)))
-    return -1;
+  memcpy(&position, curr_pos, sizeof(unsigned));
   
-  //acquire lock and find file
-  lock_acquire(&file_lock);
+  //find file and seek, position is private to the process
   struct process_file* f = find_file(thread_current(), fd);
-  if(f == NULL){
-    lock_release(&file_lock);
+  if(f == NULL)
     return -1;
-  }
-  //call seek then release lock
   file_seek(f->file, position);
-  lock_release(&file_lock);
   return 1;
 }
 
@@ -471,59 +723,42 @@ int seek(uint8_t* stack){
 int tell(uint8_t* stack){
   //copy in args
   int fd;
-  if(!copy_in(&fd, stack, sizeof(int)))
-    return 0;
+  memcpy(&fd, stack, sizeof(int));
   struct thread* t = thread_current();
-  //acquire lock and file
-  lock_acquire(&file_lock);
+  //find file and get position
   struct process_file* f = find_file(t, fd);
-  if(f == NULL){
-    lock_release(&file_lock);
+  if(f == NULL)
     return 0;
-  }
-  //get tell and release lock
-  unsigned tell = (unsigned)file_tell(f->file);
-  lock_release(&file_lock);
-  return (int)tell;
+  return (int)file_tell(f->file);
 }
 
 //Handler for SYS_CLOSE
 int close(uint8_t* stack){
   //copy in args
   int fd;
-  if(!copy_in(&fd, stack, sizeof(int)))
-    return -1;
+  memcpy(&fd, stack, sizeof(int));
 
   if(fd == STDIN_FILENO || fd == STDOUT_FILENO)
     return -1;
-  //acquire lock and file
-  lock_acquire(&file_lock);
+  //find file
   struct process_file* f = find_file(thread_current(), fd);
-  if(f == NULL){
-    lock_release(&file_lock);
+  if(f == NULL)
     return -1;
-  } 
     
   //call handler for closing process file based on process_file
-  close_proc_file(f, true);
+  close_proc_file(f);
   return 1;
 }
 
-/*Function that takes a process_file f and closes it
-if release_lock is true it will release file_lock*/
-void close_proc_file(struct process_file* f, bool release_lock){
+/*Function that takes a process_file f and closes it*/
+void close_proc_file(struct process_file* f){
   ASSERT(f != NULL);
-  //check if already holding file lock, if not acquire it
-  if(file_lock.holder != thread_current())
-    lock_acquire(&file_lock);
   //close the file and remove it from the thread's files
+  dir_close(f->dir);
   file_close(f->file);
-  list_remove(&f->elem);
+  remove_file(thread_current(), f->fd);
   //free the process_file that was allocated on create
   free(f);
-  //release lock if set to true
-  if(release_lock)
-    lock_release(&file_lock);
   return;
 }
 
@@ -534,29 +769,25 @@ int mmap(uint8_t* stack) {
 
   // Copy in arguments
   uint8_t* curr_pos = stack;
-  if(!copy_in(&fd, curr_pos, sizeof(int)))
-    return -1;
+  memcpy(&fd, curr_pos, sizeof(int));
   curr_pos += sizeof(int);
-  if(!copy_in(&addr, curr_pos, sizeof(void*)))
-    return -1;
+  memcpy(&addr, curr_pos, sizeof(void*));
 
   // Check for invalid arguments
   if(fd == 0 || fd == 1 || addr == NULL || pg_ofs(addr) != 0 || !is_user_vaddr(addr)) {
     return -1;
   }
 
-  // Acquire file lock and find file
-  lock_acquire(&file_lock);
+  // Find file
   struct file *f = NULL;
   struct process_file *pf = find_file(cur, fd);
-  if (pf && pf->file) {
+  if (pf && pf->file && pf->dir == NULL) {
     f = file_reopen(pf->file);
   }
   if(f == NULL || file_length(f) == 0){
-    lock_release(&file_lock);
+    file_close(f);
     return -1;
   }
-  lock_release(&file_lock);
 
   size_t offset;
   void *cur_addr;
@@ -604,8 +835,7 @@ int mmap(uint8_t* stack) {
 int 
 munmap(uint8_t* stack) {
   mapid_t mapid;
-  if(!copy_in(&mapid, stack, sizeof(int)))
-    return -1;
+  memcpy(&mapid, stack, sizeof(int));
   return munmap_helper(mapid);
 }
 
@@ -613,8 +843,6 @@ int
 munmap_helper(mapid_t mapid) {
   struct thread *cur = thread_current();
 
-  lock_acquire(&file_lock);
-
   // Find the mmap file corresponding to mapid
   struct mmap_file *mmap_f = find_mmap_file(cur, mapid);
 
@@ -648,11 +876,148 @@ munmap_helper(mapid_t mapid) {
   file_close(mmap_f->file);
   free(mmap_f);
 
-  lock_release(&file_lock);
   // Return
   return 1;
 }
 
+/*Handler for SYS_COPY_RANGE, copies up to length bytes from in_fd to
+out_fd at their current positions without passing through user memory.
+Returns -1 if both are the same file and the ranges overlap*/
+int copy_range(uint8_t* stack){
+  uint8_t* curr_pos = stack;
+  int in_fd, out_fd;
+  unsigned length;
+
+  //copy in args
+  memcpy(&in_fd, curr_pos, sizeof(int));
+  curr_pos += sizeof(int);
+  memcpy(&out_fd, curr_pos, sizeof(int));
+  curr_pos += sizeof(int);
+  memcpy(&length, curr_pos, sizeof(unsigned));
+
+  //find both files, console fds are not files
+  struct thread* t = thread_current();
+  struct process_file* in = find_file(t, in_fd);
+  struct process_file* out = find_file(t, out_fd);
+  if(in == NULL || out == NULL || in->dir != NULL || out->dir != NULL)
+    return -1;
+
+  return (int)file_copy(out->file, in->file, (off_t)length);
+}
+
+/*Shared body of SYS_PREAD and SYS_PWRITE, transfers size bytes
+between buffer and fd at offset without moving the file position*/
+static int
+positional_io(uint8_t* stack, bool to_file){
+  uint8_t* curr_pos = stack;
+  int fd;
+  uint8_t* buffer;
+  unsigned size, offset;
+
+  //copy in args
+  memcpy(&fd, curr_pos, sizeof(int));
+  curr_pos += sizeof(int);
+  memcpy(&buffer, curr_pos, sizeof(uint8_t*));
+  curr_pos += sizeof(uint8_t*);
+  memcpy(&size, curr_pos, sizeof(unsigned));
+  curr_pos += sizeof(unsigned);
+  memcpy(&offset, curr_pos, sizeof(unsigned));
+
+  //console fds have no positions
+  struct process_file* f = find_file(thread_current(), fd);
+  if(f == NULL || f->dir != NULL || (off_t)offset < 0)
+    return -1;
+
+  int result = pinned_file_io(f->file, buffer, (int)size, (off_t)offset,
+                              to_file);
+  if(result < 0){
+    raise_error();
+  }
+  return result;
+}
+
+/*Handler for SYS_PREAD*/
+int pread(uint8_t* stack){
+  return positional_io(stack, false);
+}
+
+/*Handler for SYS_PWRITE*/
+int pwrite(uint8_t* stack){
+  return positional_io(stack, true);
+}
+
+/*Shared body of SYS_READV and SYS_WRITEV, transfers each buffer of
+the iovec array in turn starting at fd's current position, stopping
+early at the first short transfer, and advances the position once*/
+static int
+vectored_io(uint8_t* stack, bool to_file){
+  uint8_t* curr_pos = stack;
+  int fd, iovcnt;
+  const struct iovec* uiov;
+  struct iovec iov[IOV_MAX];
+
+  //copy in args, then the iovec array itself
+  memcpy(&fd, curr_pos, sizeof(int));
+  curr_pos += sizeof(int);
+  memcpy(&uiov, curr_pos, sizeof(struct iovec*));
+  curr_pos += sizeof(struct iovec*);
+  memcpy(&iovcnt, curr_pos, sizeof(int));
+  if(iovcnt <= 0 || iovcnt > IOV_MAX)
+    return -1;
+  if(!copy_in(iov, uiov, iovcnt * sizeof(struct iovec))){
+    raise_error();
+    return -1;
+  }
+
+  //the byte count returned has to fit in an int, check before any I/O
+  size_t len = 0;
+  for(int i = 0; i < iovcnt; i++){
+    if(iov[i].iov_len > INT_MAX - len)
+      return -1;
+    len += iov[i].iov_len;
+  }
+
+  //console output goes straight to the console
+  if(fd == STDOUT_FILENO && to_file){
+    for(int i = 0; i < iovcnt; i++)
+      if(!pinned_putbuf(iov[i].iov_base, iov[i].iov_len)){
+        raise_error();
+        return -1;
+      }
+    return (int)len;
+  }
+
+  struct process_file* f = find_file(thread_current(), fd);
+  if(f == NULL || f->dir != NULL)
+    return -1;
+
+  off_t pos = file_tell(f->file);
+  int total = 0;
+  for(int i = 0; i < iovcnt; i++){
+    int done = pinned_file_io(f->file, iov[i].iov_base, (int)iov[i].iov_len,
+                              pos + total, to_file);
+    if(done < 0){
+      raise_error();
+      return -1;
+    }
+    total += done;
+    if((size_t)done < iov[i].iov_len)
+      break;
+  }
+  file_seek(f->file, pos + total);
+  return total;
+}
+
+/*Handler for SYS_READV*/
+int readv(uint8_t* stack){
+  return vectored_io(stack, false);
+}
+
+/*Handler for SYS_WRITEV*/
+int writev(uint8_t* stack){
+  return vectored_io(stack, true);
+}
+
 /*Function used to find a mmap_file of given mapid under thread
   returns NULL if no such file exists*/
 struct mmap_file*
@@ -5,10 +5,23 @@
 #include <stddef.h>
 #include "userprog/process.h"
 
+/*Calls to one syscall and the cycles spent in them*/
+struct syscall_stat {
+  uint64_t cnt;     /*Number of calls*/
+  uint64_t cycles;  /*Total cycles in calls that returned*/
+  uint64_t max;     /*Cycles in the slowest call*/
+};
+
+extern bool syscall_stats_per_process;
+
 void syscall_init (void);
+void syscall_print_stats (void);
+void syscall_print_process_stats (struct thread* t);
 
 bool copy_in (void* dst_, const void* usrc_, size_t size);
+bool copy_out (void* udst_, const void* src_, size_t size);
 
+/*Each handler gets a kernel copy of its syscall's argument words*/
 int halt ( uint8_t* stack);             /*Handler for SYS_HALT*/
 int syscall_exit( uint8_t* stack);             /*Handler for SYS_EXIT*/
 int exec( uint8_t* stack);             /*Handler for SYS_EXEC*/
@@ -24,9 +37,23 @@ int tell( uint8_t* stack);             /*Handler for SYS_TELL*/
 int close( uint8_t* stack);             /*Handler for SYS_CLOSE*/
 int mmap( uint8_t* stack);             /*Handler for SYS_MMAP*/
 int munmap( uint8_t* stack);             /*Handler for SYS_MUNMAP*/
+int copy_range( uint8_t* stack);             /*Handler for SYS_COPY_RANGE*/
+int pread( uint8_t* stack);             /*Handler for SYS_PREAD*/
+int pwrite( uint8_t* stack);             /*Handler for SYS_PWRITE*/
+int readv( uint8_t* stack);             /*Handler for SYS_READV*/
+int writev( uint8_t* stack);             /*Handler for SYS_WRITEV*/
+int chdir( uint8_t* stack);                  /*Handler for SYS_CHDIR*/
+int mkdir( uint8_t* stack);                  /*Handler for SYS_MKDIR*/
+int readdir( uint8_t* stack);                /*Handler for SYS_READDIR*/
+int isdir( uint8_t* stack);                  /*Handler for SYS_ISDIR*/
+int inumber( uint8_t* stack);                /*Handler for SYS_INUMBER*/
+int fileblocks( uint8_t* stack);             /*Handler for SYS_FILEBLOCKS*/
+int fsync( uint8_t* stack);                  /*Handler for SYS_FSYNC*/
+int wait_any( uint8_t* stack);               /*Handler for SYS_WAIT_ANY*/
+int yield( uint8_t* stack);                  /*Handler for SYS_YIELD*/
 
-/*Function that closes a file for a process, release filesys lock if release_lock is true*/
-void close_proc_file(struct process_file* f, bool release_lock);
+/*Function that closes a file for a process*/
+void close_proc_file(struct process_file* f);
 
 void proc_exit(int status);  /*Function used to exit process with statuscode status*/
 
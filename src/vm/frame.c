@@ -8,6 +8,7 @@
 #include "vm/page.h"
 #include "vm/swap.h"
 #include "threads/vaddr.h"
+#include "threads/pte.h"
 #include "kernel/bitmap.h"
 #include "lib/string.h"
 
@@ -20,6 +21,10 @@ struct hash_iterator i;
 /*boolean used to indicate whether or not iterator should start from begining*/
 bool restart_iterator = true;
 
+/*most page table entries freed per hold of frame_lock when an address
+space is torn down, so eviction isn't held up for a whole page table*/
+#define FRAME_BATCH 64
+
 /* Returns a hash value for frame f. */
 unsigned
 frame_hash (const struct hash_elem *h, void *aux UNUSED)
@@ -156,8 +161,13 @@ bool evict_frame(void){
         return false;
     }
     
+    //a process that has exited has nothing worth saving, its frames are
+    //only waiting for the reaper to free them
+    if(frame_to_evict->frame_thread->status == THREAD_DYING)
+        pagedir_clear_page(frame_to_evict->frame_thread->pagedir,
+                           frame_to_evict->user_page_addr);
     //save the frame
-    if(!save_frame(frame_to_evict))
+    else if(!save_frame(frame_to_evict))
         PANIC("failed to save frame");
     
     deallocate_frame(frame_to_evict, false);
@@ -205,23 +215,61 @@ frame_add (enum palloc_flags flags, struct thread* frame_thread) {
     return frame;
 }
 
+/* Returns the frame whose kernel page is ADDRESS, or a null
+   pointer if there is none.  frame_lock must be held. */
+static struct frame*
+frame_lookup (void* address) {
+    struct frame f;
+    struct hash_elem* e;
+    f.kernel_page_addr = address;
+    e = hash_find(&frame_table, &f.hash_elem);
+    return e != NULL ? hash_entry (e, struct frame, hash_elem) : NULL;
+}
+
 /* Returns the frame containing the given virtual address,
    or a null pointer if no such frame exists. */
 struct frame*
 frame_get (void* address) {
-    
-    struct frame f;
-    struct hash_elem* e;
-    f.kernel_page_addr = address;
     lock_acquire(&frame_lock);
-    e = hash_find(&frame_table, &f.hash_elem);
-    struct frame* result = NULL;
-    if(e != NULL)
-        result = hash_entry (e, struct frame, hash_elem);
+    struct frame* result = frame_lookup(address);
     lock_release(&frame_lock);
     return result;
 }
 
+/* Pins the frame currently backing user page UPAGE in page
+   directory PD so that it cannot be evicted.  Eviction clears the
+   mapping while holding frame_lock, so checking the mapping under
+   the same lock guarantees the pinned frame is the one mapped.
+   Returns false if UPAGE is not resident. */
+bool
+frame_pin (uint32_t* pd, const void* upage) {
+    bool success = false;
+    lock_acquire(&frame_lock);
+    void* kpage = pagedir_get_page(pd, upage);
+    if(kpage != NULL){
+        struct frame* f = frame_lookup(kpage);
+        if(f != NULL){
+            f->pinned = true;
+            success = true;
+        }
+    }
+    lock_release(&frame_lock);
+    return success;
+}
+
+/* Releases a pin taken by frame_pin(). */
+void
+frame_unpin (uint32_t* pd, const void* upage) {
+    lock_acquire(&frame_lock);
+    void* kpage = pagedir_get_page(pd, upage);
+    if(kpage != NULL){
+        struct frame* f = frame_lookup(kpage);
+        if(f != NULL)
+            f->pinned = false;
+    }
+    lock_release(&frame_lock);
+}
+
 /*function used to free from frame table using address*/
 void
 frame_free (void* address) {
@@ -234,6 +282,34 @@ frame_free (void* address) {
     return;
 }
 
+/* Frees the frames mapped by the CNT entries of page table PT and
+   clears those entries, for an address space that is no longer in
+   use.  frame_lock is taken once per FRAME_BATCH entries instead of
+   once per frame, and each entry is read under it, so a frame that
+   eviction takes away in between is not freed twice. */
+void
+frame_free_mapped (uint32_t* pt, size_t cnt) {
+    size_t i = 0;
+    while(i < cnt){
+        size_t end = cnt - i < FRAME_BATCH ? cnt : i + FRAME_BATCH;
+        lock_acquire(&frame_lock);
+        for(; i < end; i++)
+            if(pt[i] & PTE_P){
+                void* kpage = pte_get_page(pt[i]);
+                struct frame* f = frame_lookup(kpage);
+                pt[i] = 0;
+                if(f != NULL){
+                    hash_delete(&frame_table, &f->hash_elem);
+                    free(f);
+                }
+                palloc_free_page(kpage);
+            }
+        //deleting from the table invalidates the clock hand
+        restart_iterator = true;
+        lock_release(&frame_lock);
+    }
+}
+
 /*function used to deallocate frame*/
 void deallocate_frame(struct frame* f, bool use_locks){
     
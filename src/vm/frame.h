@@ -29,8 +29,14 @@ void* frame_add (enum palloc_flags flags, struct thread* frame_thread); /*functi
 
 struct frame* frame_get (void* address); /*function used to get a frame from its address*/
 
+bool frame_pin (uint32_t* pd, const void* upage); /*function used to pin the frame backing a user page*/
+
+void frame_unpin (uint32_t* pd, const void* upage); /*function used to unpin the frame backing a user page*/
+
 void frame_free (void* address); /*function used to free a frame*/
 
+void frame_free_mapped (uint32_t* pt, size_t cnt); /*function used to free the frames mapped by a page table of a dead address space*/
+
 bool save_frame(struct frame* f); /*Function used to save a frame that is being evicted*/
 
 bool evict_frame(void); /*Function used to evict a frame*/
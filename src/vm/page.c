@@ -71,36 +71,20 @@ sup_pt_find(struct list *sup_pt_list, void *upage) {
     return NULL;
 }
 
-bool sup_page_cleanup(struct list* sup_pt_list){
-    struct list_elem *e;
-    if(list_size(sup_pt_list) == 0)
-        return true;
-
+/*Function used to free every entry of a dead process's supplementary
+page table along with the swap slots its pages hold. Its frames must
+already be freed, by pagedir_destroy()*/
+void sup_page_cleanup(struct list* sup_pt_list){
     lock_acquire(&sup_pt_lock);
     while(!list_empty(sup_pt_list)){
-        e = list_pop_front(sup_pt_list);
+        struct list_elem* e = list_pop_front(sup_pt_list);
         struct sup_pt_list *spt = list_entry(e, struct sup_pt_list, elem);
-        //if loaded, release the frame
-        if(spt->loaded){
-            void* frame = pagedir_get_page(thread_current()->pagedir, spt->upage);
-            if(frame == NULL){
-                lock_release(&sup_pt_lock);
-                return false;
-            }
-           struct frame* f = frame_get(f);
-           //only need to free f since pagedir_destory is called after, which frees all allocated pages
-           free(f);
-
-        }else{
-            //if not loaded check to see if its reserved in a swap slot
-            if(spt->type == SWAP_ORIGIN){
-                unlock_swap_slot(spt->swap_slot);
-            }
-        }
-        free(spt);    
+        //a page that isn't loaded may be reserving a swap slot
+        if(!spt->loaded && spt->type == SWAP_ORIGIN)
+            unlock_swap_slot(spt->swap_slot);
+        free(spt);
     }
     lock_release(&sup_pt_lock);
-    return true;
 }
 
 bool
@@ -198,14 +182,20 @@ bool increase_stack_size(void* user_address, struct thread* t){
         return false;
     /*create supplemenal page table entry*/
     struct sup_pt_list *spt = malloc(sizeof(struct sup_pt_list));
+    if(spt == NULL){
+        frame_free(frame);
+        return false;
+    }
     spt->type = SWAP_ORIGIN;
-    spt->upage = user_address;
+    spt->upage = pg_round_down(user_address);
     spt->file = NULL;
     spt->offset = 0;
     spt->writable = true;
     spt->read_bytes = 0;
     spt->zero_bytes = 0;
+    spt->swap_slot = 0;
     spt->loaded = true;
+    lock_init(&spt->eviction_lock);
     list_push_front(&t->spt, &spt->elem);
     
     /*mapping the frames*/
@@ -217,3 +207,77 @@ bool increase_stack_size(void* user_address, struct thread* t){
 
     return true;
 }
+
+/*Brings user page UPAGE of thread T into memory the same way the
+page fault handler would, growing the stack if ADDR (the lowest
+address of the buffer within UPAGE) is close enough to the saved
+stack pointer. Returns false if the page is not part of the process*/
+static bool
+load_user_page(struct thread* t, uint8_t* upage, const uint8_t* addr){
+    struct sup_pt_list* spte = sup_pt_find(&t->spt, upage);
+    if(spte == NULL){
+        if(pagedir_get_page(t->pagedir, upage) != NULL)
+            return true;
+        if((uint8_t*) t->curr_esp - ABOVE_STACK_LIMIT <= addr
+           && MAX_STACK_SIZE >= (uint8_t*) PHYS_BASE - upage)
+            return increase_stack_size(upage, t);
+        return false;
+    }
+
+    bool success = true;
+    lock_acquire(&spte->eviction_lock);
+    if(!spte->loaded){
+        if(spte->type == FILE_ORIGIN)
+            success = sup_load_file(spte);
+        else if(spte->type == SWAP_ORIGIN)
+            success = sup_load_swap(spte);
+        else
+            success = sup_load_zero(spte);
+    }
+    lock_release(&spte->eviction_lock);
+    return success;
+}
+
+/*Makes every page of user BUFFER resident and pins its frame so the
+kernel can transfer SIZE bytes to or from it without faulting or
+having the frame evicted underneath it. WRITE is true if the kernel
+will store into the buffer. Returns false, with nothing left pinned,
+if any part of the buffer is not valid user memory*/
+bool
+sup_pin_buffer(const void* buffer, size_t size, bool write){
+    struct thread* t = thread_current();
+    const uint8_t* start = buffer;
+    if(size == 0)
+        return true;
+    if(start == NULL || start + size < start || !is_user_vaddr(start + size - 1))
+        return false;
+
+    uint8_t* first = pg_round_down(start);
+    uint8_t* upage;
+    for(upage = first; upage < start + size; upage += PGSIZE){
+        const uint8_t* addr = upage < start ? start : upage;
+        struct sup_pt_list* spte = sup_pt_find(&t->spt, upage);
+        bool ok = !(write && spte != NULL && !spte->writable);
+        //the page may be evicted again between loading and pinning
+        while(ok && !frame_pin(t->pagedir, upage))
+            ok = load_user_page(t, upage, addr);
+        if(!ok){
+            if(upage != first)
+                sup_unpin_buffer(start, upage - start);
+            return false;
+        }
+    }
+    return true;
+}
+
+/*Releases the pins taken by sup_pin_buffer()*/
+void
+sup_unpin_buffer(const void* buffer, size_t size){
+    struct thread* t = thread_current();
+    const uint8_t* start = buffer;
+    uint8_t* upage;
+    if(size == 0)
+        return;
+    for(upage = pg_round_down(start); upage < start + size; upage += PGSIZE)
+        frame_unpin(t->pagedir, upage);
+}
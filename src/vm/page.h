@@ -48,8 +48,12 @@ bool sup_load_file(struct sup_pt_list *spt);
 bool sup_load_swap(struct sup_pt_list *spt);
 bool sup_load_zero(struct sup_pt_list *spt);
 
-bool sup_page_cleanup(struct list* sup_pt_list);
+void sup_page_cleanup(struct list* sup_pt_list);
 
 bool increase_stack_size(void* user_address, struct thread* t);
 
+/* Pinning user buffers for direct kernel I/O */
+bool sup_pin_buffer(const void* buffer, size_t size, bool write);
+void sup_unpin_buffer(const void* buffer, size_t size);
+
 #endif /* vm/page.h */